@@ -17,6 +17,7 @@
 #pragma once
 
 #include <utility>
+#include <type_traits>
 
 #include <boost/preprocessor/tuple/to_list.hpp>
 #include <boost/preprocessor/list/for_each.hpp>
@@ -32,11 +33,13 @@
 #define FWD_CTOR_ADAPTER() FWD_CTOR_TBASE(Adapter)
 
 // decltype(v) instead of V is a workaround for VS compiler
+// the return type is explicit to detect const methods (see BaseSharedLocker)
 #define DECL_FN_ADAPTER(D_name) \
     template<typename... V> \
     auto D_name(V&&... v) \
     { \
-        return this->call([](auto& t, auto&&... x) { \
+        return this->call([](auto& t, auto&&... x) \
+                -> decltype(t.D_name(std::forward<decltype(x)>(x)...)) { \
             return t.D_name(std::forward<decltype(x)>(x)...); \
         }, std::forward<V>(v)...); \
     }
@@ -81,6 +84,71 @@ protected:
     }
 };
 
+namespace detail {
+
+template<typename F, typename... V>
+struct IsCallable
+{
+    template<typename G>
+    static auto test(int) -> decltype(std::declval<G&>()(std::declval<V>()...), std::true_type{});
+
+    template<typename G>
+    static std::false_type test(...);
+
+    static constexpr bool value = decltype(test<F>(0))::value;
+};
+
+}
+
+// const methods are called under the shared lock, the rest under the exclusive one
+template<typename T_base, typename T_locker>
+struct BaseSharedLocker : T_base, private T_locker
+{
+    FWD_CTOR_TBASE(BaseSharedLocker)
+protected:
+    template<typename F, typename... V>
+    auto call(F f, V&&... v)
+    {
+        return T_base::call([this, &f](auto& t, auto&&... x) {
+            using Const = const std::remove_reference_t<decltype(t)>&;
+            using IsConst = std::integral_constant<bool,
+                detail::IsCallable<F, Const, decltype(x)...>::value>;
+            return this->call0(IsConst{}, f, t, std::forward<decltype(x)>(x)...);
+        }, std::forward<V>(v)...);
+    }
+
+private:
+    template<typename F, typename T, typename... V>
+    auto call0(std::true_type, F& f, T& t, V&&... v)
+    {
+        struct Lock
+        {
+            explicit Lock(BaseSharedLocker& l) : l_{l}  { l_.T_locker::lock_shared(); }
+            ~Lock()                                     { l_.T_locker::unlock_shared(); }
+        private:
+            BaseSharedLocker& l_;
+        };
+
+        Lock _{*this};
+        return f(static_cast<const T&>(t), std::forward<V>(v)...);
+    }
+
+    template<typename F, typename T, typename... V>
+    auto call0(std::false_type, F& f, T& t, V&&... v)
+    {
+        struct Lock
+        {
+            explicit Lock(BaseSharedLocker& l) : l_{l}  { l_.T_locker::lock(); }
+            ~Lock()                                     { l_.T_locker::unlock(); }
+        private:
+            BaseSharedLocker& l_;
+        };
+
+        Lock _{*this};
+        return f(t, std::forward<V>(v)...);
+    }
+};
+
 template<typename T_base>
 struct BaseValue : T_base
 {
@@ -18,59 +18,72 @@
 
 #include <queue>
 #include <mutex>
+#include <vector>
 
 #include "synca.h"
+#include "ring.h"
 
 // TODO: refactor (remove mutex, move to once folder?) [solution: implement pimpl std mutex]
 
 namespace synca {
 
-// with iterators
+template<typename T_channel, typename T>
+struct ChannelIterator
+{
+    ChannelIterator() = default;
+    ChannelIterator(T_channel& c) : ch(&c)          { ++*this; }
+
+    T& operator*()                                  { return val; }
+    ChannelIterator& operator++()                   { if (!ch->get(val)) ch = nullptr; return *this; }
+    bool operator!=(const ChannelIterator& i) const { return ch != i.ch; }
+private:
+    T val;
+    T_channel* ch = nullptr;
+};
+
+/*
+ * With iterators.
+ * Bounded channel (capacity != 0) suspends put until a get frees the place.
+ * Waiting put/get respect journey events: cancellation and Timeout scope.
+ */
 template<typename T>
 struct Channel
 {
 public:
-    struct Iterator
-    {
-        Iterator() = default;
-        Iterator(Channel& c) : ch(&c)            { ++*this; }
+    using value_type = T;
+    using Iterator = ChannelIterator<Channel, T>;
+
+    explicit Channel(size_t capacity = 0) : capacity_{capacity} {}
 
-        T& operator*()                           { return val; }
-        Iterator& operator++()                   { if (!ch->get(val)) ch = nullptr; return *this; }
-        bool operator!=(const Iterator& i) const { return ch != i.ch; }
-    private:
-        T val;
-        Channel* ch = nullptr;
-    };
-    
     Iterator begin()                             { return {*this}; }
     static Iterator end()                        { return {}; }
-    
+
     void put(T val)
     {
         Lock lock{mutex};
         VERIFY(!closed, "Channel was closed");
-        while (!waiters_.empty())
-        {
-            Waiter w = waiters_.pop();
-            if (w.acquire())
-            {
-                lock.unlock();
-                w.set(std::move(val));
-                return;
-            }
-        }
-        queue.push(std::move(val));
+        if (put0(val, lock))
+            return;
+        bool wasSet = false;
+        putters_.push(Waiter{val, wasSet});
+        lock.unlock();
+        waitForDone();
+        VERIFY(wasSet, "Channel was closed");
     }
-    
+
+    // moves the value only on success
+    bool tryPut(T& val)
+    {
+        Lock lock{mutex};
+        VERIFY(!closed, "Channel was closed");
+        return put0(val, lock);
+    }
+
     bool get(T& val)
     {
         Lock lock{mutex};
-        if (!queue.empty())
-        {
-            val = queue.pop();
+        if (get0(val, lock))
             return true;
-        }
         if (closed)
             return false;
         bool wasSet = false;
@@ -79,74 +92,463 @@ public:
         waitForDone();
         return wasSet;
     }
-    
+
+    bool tryGet(T& val)
+    {
+        Lock lock{mutex};
+        return get0(val, lock);
+    }
+
+    // hands values to waiting getters and fills the queue under single lock
+    template<typename T_range>
+    void putMany(T_range&& range)
+    {
+        auto it = std::begin(range);
+        auto end = std::end(range);
+        while (it != end)
+        {
+            std::vector<Waiter> woken;
+            {
+                Lock lock{mutex};
+                VERIFY(!closed, "Channel was closed");
+                while (it != end && !waiters_.empty())
+                {
+                    Waiter w = waiters_.pop();
+                    if (!w.acquire())
+                        continue;
+                    w.value() = std::move(*it++);
+                    woken.emplace_back(std::move(w));
+                }
+                while (it != end && (capacity_ == 0 || queue.size() < capacity_))
+                    queue.push(std::move(*it++));
+            }
+            for (auto&& w: woken)
+                w.release();
+            // the channel is full: wait for the place
+            if (it != end)
+                put(std::move(*it++));
+        }
+    }
+
+    // waits for the first value only, returns the number of taken values
+    // 0 means closed channel
+    size_t getBatch(std::vector<T>& out, size_t maxN)
+    {
+        VERIFY(maxN > 0, "Batch size must be positive");
+        size_t n = out.size();
+        Lock lock{mutex};
+        if (queue.empty())
+        {
+            lock.unlock();
+            T val;
+            if (!get(val))
+                return 0;
+            out.emplace_back(std::move(val));
+            if (maxN == 1)
+                return 1;
+            lock.lock();
+        }
+        while (out.size() - n < maxN && !queue.empty())
+            out.emplace_back(queue.pop());
+        refill(lock);
+        return out.size() - n;
+    }
+
     bool empty() const
     {
         Lock lock{mutex};
         return queue.empty();
     }
-    
+
+    size_t size() const
+    {
+        Lock lock{mutex};
+        return queue.size();
+    }
+
+    size_t capacity() const
+    {
+        return capacity_;
+    }
+
     T get()
     {
         T val;
         get(val);
         return val;
     }
-    
+
+    // select support: takes the value now or registers the claimed waiter
+    SelectStart selectGet(T& val, bool& wasSet, const SelectClaim& claim)
+    {
+        Lock lock{mutex};
+        if (queue.empty() && !closed)
+        {
+            waiters_.push(Waiter{val, wasSet, claim});
+            return SelectStart::Waiting;
+        }
+        if (!claim.claim())
+            return SelectStart::Lost;
+        wasSet = get0(val, lock);
+        return SelectStart::Selected;
+    }
+
+    // select support: removes the registration of the lost case
+    void selectCancel(const bool& wasSet)
+    {
+        Lock lock{mutex};
+        waiters_.removeIf([&wasSet](const Waiter& w) {
+            return w.isFor(wasSet);
+        });
+    }
+
+    // waiting getters including select registrations
+    size_t waiting() const
+    {
+        Lock lock{mutex};
+        return waiters_.size();
+    }
+
     void open()
     {
         Lock lock{mutex};
         closed = false;
     }
-    
+
     void close()
     {
         Lock lock{mutex};
         if (closed)
             return;
         closed = true;
-        Queue<Waiter> ws;
+        Queue<Waiter> ws, ps;
         waiters_.swap(ws);
+        putters_.swap(ps);
         lock.unlock();
         while (!ws.empty())
             ws.pop().reset();
+        while (!ps.empty())
+            ps.pop().reset();
     }
-    
+
 private:
     using Lock = std::unique_lock<std::mutex>;
 
     struct Waiter
     {
-        explicit Waiter(T& t, bool& wasSet) : t_{&t}, wasSet_{&wasSet} {}
+        explicit Waiter(T& t, bool& wasSet, SelectClaim claim = {})
+            : t_{&t}, wasSet_{&wasSet}, claim_{std::move(claim)} {}
 
         bool acquire()
         {
-            return doer_.acquire();
+            return claim_.claim() && doer_.acquire();
         }
 
-        void set(T t) noexcept
+        // valid only after acquire
+        T& value()
+        {
+            return *t_;
+        }
+
+        void release() noexcept
         {
-            *t_ = std::move(t); // move must be noexcept
             *wasSet_ = true;
             doer_.releaseAndDone();
         }
 
+        void set(T t) noexcept
+        {
+            *t_ = std::move(t); // move must be noexcept
+            release();
+        }
+
         void reset() noexcept
         {
-            doer_.done();
+            if (claim_.claim())
+                doer_.done();
+        }
+
+        bool isFor(const bool& wasSet) const
+        {
+            return wasSet_ == &wasSet;
         }
 
     private:
         T* t_;
         bool* wasSet_;
+        SelectClaim claim_;
         DetachableDoer doer_;
     };
 
+    // returns false if the channel is full, unlocks on handing over to getter
+    bool put0(T& val, Lock& lock)
+    {
+        while (!waiters_.empty())
+        {
+            Waiter w = waiters_.pop();
+            if (w.acquire())
+            {
+                lock.unlock();
+                w.set(std::move(val));
+                return true;
+            }
+        }
+        if (capacity_ != 0 && queue.size() >= capacity_)
+            return false;
+        queue.push(std::move(val));
+        return true;
+    }
+
+    // takes the value and moves the first waiting putter into the queue
+    bool get0(T& val, Lock& lock)
+    {
+        if (queue.empty())
+            return false;
+        val = queue.pop();
+        refill(lock);
+        return true;
+    }
+
+    // moves waiting putters into the free places and wakes them after unlock
+    void refill(Lock& lock)
+    {
+        if (putters_.empty())
+            return;
+        std::vector<Waiter> woken;
+        while (!putters_.empty() && (capacity_ == 0 || queue.size() < capacity_))
+        {
+            Waiter w = putters_.pop();
+            if (!w.acquire())
+                continue;
+            queue.push(std::move(w.value()));
+            woken.emplace_back(std::move(w));
+        }
+        lock.unlock();
+        for (auto&& w: woken)
+            w.release();
+    }
+
     //Waiters waiters;
     mutable std::mutex mutex;
     Queue<T> queue;
     Queue<Waiter> waiters_;
+    Queue<Waiter> putters_;
+    size_t capacity_;
     bool closed = false;
 };
 
+// select case: receives from the channel, not ok if the channel is closed
+template<typename T>
+struct SelectRecv
+{
+    SelectRecv(Channel<T>& c, T& val) : c_{c}, val_{val} {}
+
+    SelectStart start(const SelectClaim& claim)
+    {
+        return c_.selectGet(val_, wasSet_, claim);
+    }
+
+    void stop()
+    {
+        c_.selectCancel(wasSet_);
+    }
+
+    bool ok() const
+    {
+        return wasSet_;
+    }
+
+private:
+    Channel<T>& c_;
+    T& val_;
+    bool wasSet_ = false;
+};
+
+template<typename T>
+SelectRecv<T> recv(Channel<T>& c, T& val)
+{
+    return {c, val};
+}
+
+// lock-free bounded channel: the mutex is taken only to park
+// the journey on empty (get) or full (put) ring
+template<typename T, typename T_policy = Mpmc>
+struct RingChannel
+{
+public:
+    using value_type = T;
+    using Iterator = ChannelIterator<RingChannel, T>;
+
+    explicit RingChannel(size_t capacity = 1024) : ring_{capacity} {}
+
+    Iterator begin()                             { return {*this}; }
+    static Iterator end()                        { return {}; }
+
+    void put(T val)
+    {
+        while (true)
+        {
+            VERIFY(!closed_.load(std::memory_order_relaxed), "Channel was closed");
+            if (ring_.push(val))
+            {
+                wakeOne(getters_, getWaiting_);
+                return;
+            }
+            {
+                Lock lock{mutex_};
+                if (!prepareWait(putWaiting_, [&] { return ring_.push(val); }))
+                {
+                    lock.unlock();
+                    wakeOne(getters_, getWaiting_);
+                    return;
+                }
+                if (closed_.load(std::memory_order_relaxed))
+                {
+                    putWaiting_.fetch_sub(1, std::memory_order_relaxed);
+                    raiseException("Channel was closed");
+                }
+                putters_.push(DetachableDoer{});
+            }
+            waitForDone();
+        }
+    }
+
+    bool get(T& val)
+    {
+        while (true)
+        {
+            if (ring_.pop(val))
+            {
+                wakeOne(putters_, putWaiting_);
+                return true;
+            }
+            {
+                Lock lock{mutex_};
+                if (!prepareWait(getWaiting_, [&] { return ring_.pop(val); }))
+                {
+                    lock.unlock();
+                    wakeOne(putters_, putWaiting_);
+                    return true;
+                }
+                if (closed_.load(std::memory_order_relaxed))
+                {
+                    getWaiting_.fetch_sub(1, std::memory_order_relaxed);
+                    return false;
+                }
+                getters_.push(DetachableDoer{});
+            }
+            waitForDone();
+        }
+    }
+
+    // moves the value only on success
+    bool tryPut(T& val)
+    {
+        VERIFY(!closed_.load(std::memory_order_relaxed), "Channel was closed");
+        if (!ring_.push(val))
+            return false;
+        wakeOne(getters_, getWaiting_);
+        return true;
+    }
+
+    bool tryGet(T& val)
+    {
+        if (!ring_.pop(val))
+            return false;
+        wakeOne(putters_, putWaiting_);
+        return true;
+    }
+
+    T get()
+    {
+        T val;
+        get(val);
+        return val;
+    }
+
+    bool empty() const
+    {
+        return ring_.empty();
+    }
+
+    size_t capacity() const
+    {
+        return ring_.capacity();
+    }
+
+    void open()
+    {
+        Lock lock{mutex_};
+        closed_.store(false, std::memory_order_relaxed);
+    }
+
+    void close()
+    {
+        Lock lock{mutex_};
+        if (closed_.load(std::memory_order_relaxed))
+            return;
+        closed_.store(true, std::memory_order_relaxed);
+        Waiters gs, ps;
+        getters_.swap(gs);
+        putters_.swap(ps);
+        getWaiting_.store(0, std::memory_order_relaxed);
+        putWaiting_.store(0, std::memory_order_relaxed);
+        lock.unlock();
+        while (!gs.empty())
+            gs.pop().done();
+        while (!ps.empty())
+            ps.pop().done();
+    }
+
+private:
+    using Lock = std::unique_lock<std::mutex>;
+    using Waiters = Queue<DetachableDoer>;
+    using Ring = typename T_policy::template Ring<T>;
+
+    /*
+     * Under mutex. Publishes the waiter counter before the last ring check:
+     * the opposite side either sees the counter or we see its ring change.
+     * Returns false if the operation succeeded without waiting.
+     * Woken journey retries from the beginning.
+     */
+    template<typename F>
+    bool prepareWait(Atomic<size_t>& waiting, F tryOp)
+    {
+        waiting.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!tryOp())
+            return true;
+        waiting.fetch_sub(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    void wakeOne(Waiters& ws, Atomic<size_t>& waiting)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting.load(std::memory_order_relaxed) == 0)
+            return;
+        Lock lock{mutex_};
+        while (!ws.empty())
+        {
+            DetachableDoer d = ws.pop();
+            waiting.fetch_sub(1, std::memory_order_relaxed);
+            // the journey may be cancelled or timed out already
+            if (d.acquire())
+            {
+                lock.unlock();
+                d.releaseAndDone();
+                return;
+            }
+        }
+    }
+
+    Ring ring_;
+    mutable std::mutex mutex_;
+    Waiters getters_;
+    Waiters putters_;
+    Atomic<size_t> getWaiting_;
+    Atomic<size_t> putWaiting_;
+    std::atomic<bool> closed_ {false};
+};
+
 }
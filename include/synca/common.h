@@ -159,6 +159,11 @@ struct Queue
         return q_.empty();
     }
 
+    size_t size() const
+    {
+        return q_.size();
+    }
+
     T pop()
     {
         T t{std::move(q_.front())};
@@ -176,6 +181,19 @@ struct Queue
         q_.swap(q.q_);
     }
 
+    // keeps the order of the rest
+    template<typename F>
+    void removeIf(F f)
+    {
+        std::queue<T> rest;
+        for (; !q_.empty(); q_.pop())
+        {
+            if (!f(q_.front()))
+                rest.emplace(std::move(q_.front()));
+        }
+        q_.swap(rest);
+    }
+
 private:
     std::queue<T> q_;
 };
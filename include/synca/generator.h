@@ -0,0 +1,121 @@
+/*
+ * Copyright 2015 Grigory Demchenko (aka gridem)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "synca.h"
+#include "channel.h"
+
+namespace synca {
+
+namespace detail {
+
+// owns the producer coroutine, see Generator
+struct GeneratorBase
+{
+protected:
+    explicit GeneratorBase(Handler producer);
+    ~GeneratorBase();
+
+    // resumes the producer until it yields or completes
+    // returns false on completion, rethrows producer exception
+    bool resume();
+
+    // returns control to the consumer, called from the producer only
+    void yield();
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+}
+
+/*
+ * Pull-based lazy stream: get() resumes the producer directly on the
+ * consumer stack until the next value, no scheduler and no locking.
+ * Producer is started lazily on the first get() and may use any
+ * synca operation: it runs inside the consumer journey.
+ * Destroying unfinished generator unwinds the producer stack.
+ * Single consumer only.
+ */
+template<typename T>
+struct Generator : private detail::GeneratorBase
+{
+    using value_type = T;
+    using Iterator = ChannelIterator<Generator, T>;
+
+    struct Yield
+    {
+        void operator()(T t)
+        {
+            g_.value_ = std::move(t);
+            g_.yield();
+        }
+
+    private:
+        friend struct Generator;
+
+        explicit Yield(Generator& g) : g_(g) {}
+
+        Generator& g_;
+    };
+
+    template<typename F_producer>
+    explicit Generator(F_producer f)
+        : detail::GeneratorBase([this, f]() mutable {
+            Yield y{*this};
+            f(y);
+        })
+    {
+    }
+
+    Generator(const Generator&) = delete;
+    Generator& operator=(const Generator&) = delete;
+
+    Iterator begin()                                 { return {*this}; }
+    static Iterator end()                            { return {}; }
+
+    bool get(T& t)
+    {
+        if (!resume())
+            return false;
+        t = std::move(value_);
+        return true;
+    }
+
+    // the same as Channel::getBatch: appends up to maxN values,
+    // returns the number of taken values, 0 means the end
+    size_t getBatch(std::vector<T>& ts, size_t maxN)
+    {
+        VERIFY(maxN > 0, "Batch size must be positive");
+        size_t n = 0;
+        T t;
+        while (n < maxN && get(t))
+        {
+            ts.push_back(std::move(t));
+            ++ n;
+        }
+        return n;
+    }
+
+private:
+    T value_;
+};
+
+}
@@ -18,6 +18,7 @@
 
 //#include <queue>
 #include <mutex>
+#include <shared_mutex>
 
 #include "synca.h"
 
@@ -28,6 +29,8 @@ namespace synca {
 struct Mutex
 {
     Mutex();
+    // spinCount: tries to take the lock before suspending the journey
+    explicit Mutex(int spinCount);
     ~Mutex();
 
     void lock();
@@ -42,4 +45,24 @@ private:
 
 using Lock = std::unique_lock<Mutex>;
 
+// shared/exclusive lock for journeys, snake case names follow std::shared_lock
+struct SharedMutex
+{
+    SharedMutex();
+    ~SharedMutex();
+
+    void lock();
+    void unlock();
+    void lock_shared();
+    void unlock_shared();
+
+private:
+    using Lock = std::unique_lock<std::mutex>;
+
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+using SharedLock = std::shared_lock<SharedMutex>;
+
 }
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2015 Grigory Demchenko (aka gridem)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+namespace synca {
+
+using CodecId = uint32_t;
+
+constexpr CodecId c_noCodec = 0;
+constexpr CodecId c_lzCodec = 1; // built-in fast LZ77 codec
+constexpr size_t c_compressionThreshold = 4096;
+
+// the compressed payload (c_flagCompressed) starts with the header
+struct CompressedHeader
+{
+    CodecId codec;
+    uint32_t rawSize;
+};
+
+struct ICodec : IObject
+{
+    virtual CodecId id() const = 0;
+    // appends the compressed data
+    virtual void compress(View src, Buffer& dst) = 0;
+    // dst has the exact size of the raw data
+    virtual void decompress(View src, View dst) = 0;
+};
+
+void registerCodec(std::shared_ptr<ICodec> codec);
+std::shared_ptr<ICodec> findCodec(CodecId id);
+
+// applies to the packets larger than the threshold, the receivers decode
+// any registered codec thus the nodes may use different settings
+void setCompression(CodecId codec, size_t threshold = c_compressionThreshold);
+
+// returns the packet as is if the compression is disabled or useless
+Buffer compressPacket(Buffer packet);
+// the payload of the packet with c_flagCompressed
+size_t decompressedSize(View payload);
+void decompressPayload(View payload, View raw);
+
+}
@@ -65,15 +65,27 @@ struct Connector
 
     void write(View);
     void write(std::initializer_list<View>);
+    // reconnects on network errors, reports cancel, timeout and disconnect
+    Result<> tryWrite(View);
+    Result<> tryWrite(std::initializer_list<View>);
     void disconnect();
 
 private:
-    void reconnect();
+    Result<> tryReconnect();
 
     template<typename F>
-    void performOp(F f)
+    Result<> tryPerformOp(F f)
     {
-        networkRetry(f, [&] { reconnect(); });
+        while (true)
+        {
+            Result<> r = f();
+            if (r.status() != Status::Failed)
+                return r;
+            JLOG("retrying on: " << r.error());
+            r = tryReconnect();
+            if (!r)
+                return r;
+        }
     }
 
     Socket socket_;
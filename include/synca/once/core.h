@@ -30,6 +30,9 @@ int index();
 Goer go(Handler handler, IScheduler& scheduler);
 Goer go(Handler handler);
 void goN(int n, Handler handler);
+// run-to-completion handler without journey: cannot wait, teleport etc
+void post(Handler handler, IScheduler& scheduler);
+void post(Handler handler);
 
 void teleport(IScheduler& scheduler);
 void handleEvents();
@@ -40,6 +43,8 @@ void enableEventsAndCheck();
 void waitForAll();
 void deferProceed(ProceedHandler proceed);
 void waitForDone();
+// the same as waitForDone but returns cancel/timeout instead of throwing
+Status tryWaitForDone();
 void goWait(std::initializer_list<Handler> handlers);
 void goWait2(std::initializer_list<Handler> handlers);
 void reschedule();
@@ -236,6 +241,64 @@ boost::optional<T_result> goAnyResult(std::initializer_list<std::function<boost:
     return result;
 }
 
+namespace detail {
+
+// the state of goFirst placed on the caller stack
+struct FirstState
+{
+    void start();
+    bool hasWinner() const;
+    // the first successful handler wins
+    bool tryWin(size_t index);
+    void finish(bool won);
+    // waits for the finished winner or for all handlers finished
+    Status waitReady();
+    // waits for all handlers finished ignoring the events
+    void drain();
+
+private:
+    using Lock = std::unique_lock<std::mutex>;
+
+    bool ready0() const;
+    void wait0(Lock& lock);
+
+    static constexpr size_t c_none = static_cast<size_t>(-1);
+
+    mutable std::mutex mutex_;
+    size_t running_ = 0;
+    size_t winner_ = c_none;
+    bool winnerDone_ = false;
+    boost::optional<DetachableDoer> waiter_;
+};
+
+using FirstRun = std::function<bool(size_t index, FirstState& state)>;
+
+void goFirst(size_t n, int hedgeMs, const FirstRun& run);
+
+}
+
+/*
+ * Returns the first successful result, the losers are cancelled
+ * and finished before returning.
+ * hedgeMs > 0 staggers the launch: handler i starts after i * hedgeMs
+ * unless there is a winner already.
+ */
+template<typename T_result>
+boost::optional<T_result> goFirst(
+    std::initializer_list<std::function<boost::optional<T_result>()>> handlers, int hedgeMs = 0)
+{
+    boost::optional<T_result> result;
+    auto begin = handlers.begin();
+    detail::goFirst(handlers.size(), hedgeMs, [&result, begin](size_t i, detail::FirstState& state) {
+        auto r = begin[i]();
+        if (!r || !state.tryWin(i))
+            return false;
+        result = std::move(r);
+        return true;
+    });
+    return result;
+}
+
 // TODO: consider using waitForAll in dtor
 struct Alone : IScheduler
 {
@@ -264,6 +327,151 @@ private:
 
 void sleepa(int ms);
 
+/*
+ * select: single waiter registered on several event sources at once.
+ * The first source that claims the shared state wakes the journey,
+ * the rest of registrations become stale and are skipped by their sources.
+ */
+namespace detail {
+
+struct SelectState
+{
+    static constexpr size_t c_none = static_cast<size_t>(-1);
+
+    bool tryWin(size_t index)
+    {
+        size_t none = c_none;
+        return winner.compare_exchange_strong(none, index, std::memory_order_acq_rel);
+    }
+
+    Atomic<size_t> winner {c_none};
+};
+
+}
+
+enum class SelectStart
+{
+    Waiting,    // registered, wait for the source
+    Selected,   // ready immediately, claimed by the journey itself
+    Lost,       // another source has claimed already
+};
+
+struct SelectClaim
+{
+    SelectClaim() = default;
+    SelectClaim(std::shared_ptr<detail::SelectState> state, size_t index)
+        : state_{std::move(state)}, index_{index} {}
+
+    // regular (non select) waiters can always be claimed
+    bool claim() const
+    {
+        return !state_ || state_->tryWin(index_);
+    }
+
+private:
+    std::shared_ptr<detail::SelectState> state_;
+    size_t index_ = 0;
+};
+
+struct SelectResult
+{
+    size_t index;
+    bool ok; // false for closed channel
+};
+
+// select case: fires after timeout
+struct SelectAfter
+{
+    explicit SelectAfter(int ms);
+    SelectAfter(SelectAfter&&);
+    ~SelectAfter();
+
+    SelectStart start(const SelectClaim& claim);
+    void stop();
+    bool ok() const { return true; }
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+    int ms_;
+};
+
+inline SelectAfter after(int ms)
+{
+    return SelectAfter{ms};
+}
+
+// select case: fires when the journey ends
+struct SelectEnded
+{
+    explicit SelectEnded(Goer goer) : goer_{std::move(goer)} {}
+
+    SelectStart start(const SelectClaim& claim);
+    void stop();
+    bool ok() const { return true; }
+
+private:
+    Goer goer_;
+    size_t id_ = 0;
+};
+
+inline SelectEnded ended(Goer goer)
+{
+    return SelectEnded{std::move(goer)};
+}
+
+// cancellation and timeout of the journey are raised as usual,
+// the cases that have not fired are deregistered on return
+template<typename... V>
+SelectResult select(V&&... cases)
+{
+    auto state = std::make_shared<detail::SelectState>();
+    SelectStart st = SelectStart::Waiting;
+    size_t started = 0;
+    auto start = [&](auto& c) {
+        if (st != SelectStart::Waiting)
+            return;
+        st = c.start(SelectClaim{state, started});
+        ++ started;
+    };
+    int expand[] = {0, (start(cases), 0)...};
+    (void) expand;
+    // the winner is unknown if the wait has thrown: all the cases are stopped
+    auto stopLost = [&] {
+        size_t winner = state->winner.load(std::memory_order_acquire);
+        size_t i = 0;
+        auto stop = [&](auto& c) {
+            if (i < started && i != winner)
+                c.stop();
+            ++ i;
+        };
+        int expandStop[] = {0, (stop(cases), 0)...};
+        (void) expandStop;
+    };
+    if (st != SelectStart::Selected)
+    {
+        try
+        {
+            waitForDone();
+        }
+        catch (...)
+        {
+            stopLost();
+            throw;
+        }
+    }
+    stopLost();
+    SelectResult result {state->winner.load(std::memory_order_acquire), true};
+    size_t i = 0;
+    auto ok = [&](auto& c) {
+        if (i++ == result.index)
+            result.ok = c.ok();
+    };
+    int expandOk[] = {0, (ok(cases), 0)...};
+    (void) expandOk;
+    return result;
+}
+
 struct Timer
 {
     Timer();
@@ -307,6 +515,7 @@ struct Scheduler
 {
     void attach(IScheduler& s);
     void detach();
+    bool attached() const;
 
     operator IScheduler&() const;
 
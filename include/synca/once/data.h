@@ -104,4 +104,33 @@ void piping1to01(T_src& s, T_dst& d, F_pipe f, int n = 1)
     }, n);
 }
 
+// batched variants: f processes whole vectors taken by getBatch
+template<typename T_src, typename T_dst, typename F_pipe>
+void pipingBatch1toMany(T_src& s, T_dst& d, F_pipe f, size_t batch, int n = 1)
+{
+    piping(s, d, [f, batch] (T_src& s, T_dst& d) {
+        std::vector<typename T_src::value_type> vs;
+        while (s.getBatch(vs, batch))
+        {
+            try
+            {
+                f(vs, d);
+            }
+            catch (std::exception& e)
+            {
+                logException(e);
+            }
+            vs.clear();
+        }
+    }, n);
+}
+
+template<typename T_src, typename T_dst, typename F_pipe>
+void pipingBatch1to1(T_src& s, T_dst& d, F_pipe f, size_t batch, int n = 1)
+{
+    pipingBatch1toMany(s, d, [f] (auto& vs, T_dst& d) {
+        d.putMany(f(vs));
+    }, batch, n);
+}
+
 }
@@ -57,6 +57,13 @@ struct Socket
     void connect(const Endpoint& e);
     void close();
 
+    // exception-free variants: cancel, timeout and network errors are returned
+    Result<> tryRead(View);
+    Result<size_t> tryPartialRead(View);
+    Result<> tryWrite(View);
+    Result<> tryWrite(std::initializer_list<View>);
+    Result<> tryConnect(const Endpoint& e);
+
     struct Impl;
 private:
     std::shared_ptr<Impl> socket;
@@ -59,15 +59,40 @@ struct NodesConfig
     NodeId thisNode() const;
 
 private:
-    NodeId thisNode_;
+    NodeId thisNode_ = 0;
     std::unordered_map<NodeId, Endpoint> nodes_;
 };
 
+// optional pool for the byte work: serialization, compression, checksums
+// and deserialization, only the execution remains on scheduler<DefaultTag>
+struct CodecTag;
+
+// teleports the journey to scheduler<CodecTag> for the handler and returns it
+// back, runs in place if the scheduler is not attached or outside of journeys
+void runOnCodec(const Handler& handler);
+
+// receives the large message by chunks instead of reassembling in memory,
+// write runs on the codec threads if scheduler<CodecTag> is attached
+struct IStreamSink : IObject
+{
+    virtual void write(View chunk) = 0;
+    virtual void done() = 0;
+};
+
+using StreamSinkFactory = std::function<std::unique_ptr<IStreamSink>(uint64_t totalSize)>;
+// returns the next chunk up to c_fragmentSize, valid until the next call
+using StreamSource = std::function<View()>;
+using FrameWriter = std::function<void(std::initializer_list<View>)>;
+using FrameReader = std::function<void(View)>;
+
 struct Nodes : WithCleanup
 {
     size_t count() const;
     void add(NodeId id, Endpoint);
     void send(NodeId id, View view);
+    void sendStream(NodeId id, MsgTypeId type, uint64_t totalSize, const StreamSource& source);
+    void writeFrame(NodeId id, std::initializer_list<View> frame);
+    void checkConnected(NodeId id); // throws NodeError
     bool remove(NodeId id); // returns false if the node has been removed already
     void cleanup() override;
 
@@ -79,6 +104,49 @@ private:
     std::unordered_map<NodeId, SharedConnector> nodes_;
 };
 
+void registerStreamSink(MsgTypeId type, StreamSinkFactory factory);
+
+// splits the packets larger than the fragment size
+void writePacket(const FrameWriter& write, View packet);
+void writeStream(const FrameWriter& write, MsgTypeId type, uint64_t totalSize, const StreamSource& source);
+
+// writes the packets to the connection in the order of the reservations
+// frame by frame: the small packets wait for a single fragment of the large
+// ones instead of the whole packet thus they may be received earlier
+struct Outbox
+{
+    using Packet = std::shared_ptr<Buffer>;
+    struct Slot;
+    using SlotPtr = std::shared_ptr<Slot>;
+
+    explicit Outbox(FrameWriter write);
+    ~Outbox();
+
+    SlotPtr reserve(); // doesn't suspend
+    // the journey filling the slot writes the ready packets unless the other
+    // one is writing, nullptr packet releases the slot, the write failure
+    // drops the rest of the packet
+    void fill(const SlotPtr& slot, Packet packet);
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+// reads the frames, reassembles the fragments and invokes the messages
+struct PacketReceiver
+{
+    // the streams above maxReassembled in total are rejected
+    explicit PacketReceiver(FrameReader read, uint64_t maxReassembled = c_maxReassembledSize);
+    ~PacketReceiver();
+
+    void receive(); // handles single frame
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
 struct MsgListener : WithCleanup
 {
     ~MsgListener();
@@ -108,5 +176,36 @@ UniqueId genUniqueId();
 NodeId thisNode();
 void send(NodeId dst, AnyMsg msg);
 void broadcast(AnyMsg msg);
+// the packets are compressed according to setCompression,
+// broadcast compresses once for all the nodes
+// send and broadcast don't suspend: the packets are encoded and written by
+// the spawned journeys through the Outbox of the node
+// send throws NodeError for the absent or disconnected node, the failures
+// of the encoding and writing are logged only and the packet is lost
+void sendPacket(NodeId dst, Buffer buf);
+void broadcastPacket(Buffer buf);
+void sendStream(NodeId dst, MsgTypeId type, uint64_t totalSize, StreamSource source);
+
+// returns the packet, invoked by runOnCodec after the send returns
+using PacketSerializer = std::function<Buffer()>;
+void sendSerialized(NodeId dst, PacketSerializer serialize);
+void broadcastSerialized(PacketSerializer serialize);
+
+// registered messages, see REGISTER_MSG
+template<typename T, typename = typename std::enable_if<detail::HasMsgType<T>::value>::type>
+void send(NodeId dst, const T& msg)
+{
+    sendSerialized(dst, [msg] {
+        return serializeMsgToPacket(msg);
+    });
+}
+
+template<typename T, typename = typename std::enable_if<detail::HasMsgType<T>::value>::type>
+void broadcast(const T& msg)
+{
+    broadcastSerialized([msg] {
+        return serializeMsgToPacket(msg);
+    });
+}
 
 }
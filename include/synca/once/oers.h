@@ -32,6 +32,78 @@ DECL_EXC(Event, Error, "Event received")
 DECL_EXC(CancelledEvent, Event, "Cancel")
 DECL_EXC(TimedoutEvent, Event, "Timeout")
 
+// exception-free counterpart of the events and errors
+enum class Status
+{
+    Ok,
+    Cancelled,  // CancelledEvent
+    Timedout,   // TimedoutEvent
+    Failed,     // operation error, see Result::error
+};
+
+// throws CancelledEvent or TimedoutEvent, does nothing for the rest
+void raise(Status status);
+
+template<typename T_error>
+void raise(Status status, const std::string& error)
+{
+    raise(status);
+    if (status == Status::Failed)
+        throw T_error{error};
+}
+
+// expected-style result: events and errors are returned instead of thrown
+template<typename T = void>
+struct Result
+{
+    Result(T value) : value_(std::move(value)) {}
+    Result(Status status, std::string error = {}) : status_{status}, error_{std::move(error)} {}
+
+    bool ok() const                     { return status_ == Status::Ok; }
+    explicit operator bool() const      { return ok(); }
+    Status status() const               { return status_; }
+    const std::string& error() const    { return error_; }
+
+    // exception API on top: raises the event or T_error on failure
+    template<typename T_error = Error>
+    T& value()
+    {
+        raise<T_error>(status_, error_);
+        return value_;
+    }
+
+private:
+    Status status_ = Status::Ok;
+    T value_ {};
+    std::string error_;
+};
+
+template<>
+struct Result<void>
+{
+    Result() = default;
+    Result(Status status, std::string error = {}) : status_{status}, error_{std::move(error)} {}
+
+    // drops the value
+    template<typename T>
+    explicit Result(const Result<T>& r) : status_{r.status()}, error_{r.error()} {}
+
+    bool ok() const                     { return status_ == Status::Ok; }
+    explicit operator bool() const      { return ok(); }
+    Status status() const               { return status_; }
+    const std::string& error() const    { return error_; }
+
+    template<typename T_error = Error>
+    void value() const
+    {
+        raise<T_error>(status_, error_);
+    }
+
+private:
+    Status status_ = Status::Ok;
+    std::string error_;
+};
+
 struct JourneyState;
 
 // TODO: only Goer should be available for user. consider move to journey
@@ -54,6 +126,9 @@ struct Goer
 
     void cancel();
     void timedout();
+    // the handler is invoked on the journey end, returns 0 if it has ended
+    size_t onEnded(Handler handler);
+    void removeEnded(size_t id);
 
 private:
     // TODO: consider weak_ptr
@@ -130,6 +130,12 @@ struct CarryMsg2
     {
         return msgId < m.msgId;
     }
+
+    template<typename V>
+    void serializeFields(V& v)
+    {
+        v(msg, msgId);
+    }
 };
 
 using CarrySet = std::set<CarryMsg2>;
@@ -160,6 +166,55 @@ inline std::ostream& operator<<(std::ostream& o, const CarryMsg2& m)
     return o << "{" << m.msgId.first << "," << m.msgId.second << "}";
 }
 
+/*
+ * Registered voting messages: the frames carry the message ids instead of
+ * code pointers (see REGISTER_MSG), the applied user messages are still
+ * carried as images.
+ */
+struct VoteMsg
+{
+    static constexpr MsgTypeId msgType = 1;
+
+    StepId stepId;
+    CarrySet carries;
+    NodeId srcNode;
+    NodesSet nodes;
+
+    template<typename V>
+    void serializeFields(V& v)
+    {
+        v(stepId, carries, srcNode, nodes);
+    }
+
+    void operator()();
+};
+
+struct CommitMsg
+{
+    static constexpr MsgTypeId msgType = 2;
+
+    StepId stepId;
+    CarrySet carries;
+
+    template<typename V>
+    void serializeFields(V& v)
+    {
+        v(stepId, carries);
+    }
+
+    void operator()();
+};
+
+// the registrations are in replob.cpp: the static library drops the unit
+// unless the binary references it, thus every includer does
+bool linkReplobMsgs();
+
+namespace {
+
+const bool g_replobMsgsLinked = linkReplobMsgs();
+
+}
+
 struct Voting : Phantomer<Voting>
 {
     enum struct State
@@ -212,7 +267,7 @@ struct Voting : Phantomer<Voting>
         {
             state_ = State::Voted;
             // TODO: use broadcastSet().<method>(nodes_set, ...)
-            broadcast().vote(carries_, thisNode(), nodes_);
+            synca::broadcast(VoteMsg{stepId(), carries_, thisNode(), nodes_});
         }
     }
 
@@ -225,7 +280,7 @@ struct Voting : Phantomer<Voting>
         VLOG("COMMIT: " << carrySet);
         state_ = State::Completed;
         carries_ = carrySet;
-        broadcast().commit(carries_);
+        synca::broadcast(CommitMsg{stepId(), carries_});
         complete();
     }
 
@@ -16,85 +16,175 @@
 
 namespace synca {
 
-Buffer& tlsBuffer();
-
 constexpr size_t c_ptrSize = sizeof(Ptr);
 constexpr size_t c_intSize = sizeof(int);
+constexpr size_t c_arenaInitialSize = 64 * 1024;
+constexpr size_t c_arenaMaxSize = size_t(1) << 31;
+
+// thread arena memory: allocated on demand, not initialized
+View& tlsArena();
+
+// replaces the thread arena by the twice larger one, the content is lost
+void growArena();
+
+// the beginning of the thread arena with the size, grows the arena if needed
+View arenaReserve(size_t size);
 
+// thrown on arena exhaustion, doesn't allocate the memory
+struct ArenaOverflow : std::bad_alloc
+{
+    const char* what() const noexcept override;
+};
+
+// explicit arena: allocations are served from the thread arena,
+// reset is O(1): the next allocator starts from the beginning
 struct MemoryAllocator// : IAllocator
 {
     MemoryAllocator();
-    ~MemoryAllocator();
 
     void* alloc(size_t sz);
     void dealloc(void *p);
+    Ptr data() const;
     size_t size() const;
     void setSize(size_t size);
 
 private:
     size_t offset_ = 0;
-    Buffer& buffer_;
+    View& arena_;
+};
+
+// binds the arena to the current thread for nested allocations performed
+// by copy constructors (e.g. std::function heap block), requires
+// ARENA_NEW build option, otherwise nested allocations use the heap
+struct ArenaScope
+{
+    explicit ArenaScope(MemoryAllocator& a);
+    ~ArenaScope();
+
+private:
+    MemoryAllocator* prev_;
 };
 
-// TODO: consider using copy interface and hide the implementation
-// need to copy to buffer immediately
 template<typename T>
-View serialize(const T& obj)
+T* arenaNew(MemoryAllocator& a, const T& obj)
+{
+    return new (a.alloc(sizeof(T))) T{obj};
+}
+
+/*
+ * Image layout: the object image is followed by the bitmap of pointer
+ * slots (one bit per pointer-sized word) and by the trailer.
+ */
+using BitmapWord = uint64_t;
+constexpr size_t c_bitmapBits = sizeof(BitmapWord) * 8;
+
+struct ImageTrailer
+{
+    uint32_t imageSize;
+    uint32_t bitmapWords;
+};
+
+View bufToView(Buffer& b);
+
+// relocates the pointers in-place, returns the image
+Ptr relocate(View v);
+
+namespace detail {
+
+// trivially copyable objects and pointer-free closures: flat image
+// with empty relocation table, no copy constructor calls
+template<typename T>
+View serialize(const T& obj, std::true_type)
+{
+    constexpr size_t size = (sizeof(T) + c_intSize - 1) / c_intSize * c_intSize;
+    View v = arenaReserve(size + sizeof(ImageTrailer));
+    std::memcpy(v.data, &obj, sizeof(T));
+    std::memset(v.data + sizeof(T), 0, size - sizeof(T));
+    ImageTrailer trailer{size, 0};
+    std::memcpy(v.data + size, &trailer, sizeof(trailer));
+    return v;
+}
+
+template<typename T>
+View serialize(const T& obj, std::false_type)
 {
-    View v {tlsBuffer().data(), 0};
+    View v;
     size_t total;
+    while (true)
     {
         MemoryAllocator a;
-        new T{obj};
-        v.size = a.size();
-        new T{obj};
-        total = a.size();
+        try
+        {
+            ArenaScope scope{a};
+            arenaNew(a, obj);
+            v.size = a.size();
+            arenaNew(a, obj);
+            total = a.size();
+            a.alloc(sizeof(ImageTrailer));
+        }
+        catch (ArenaOverflow&)
+        {
+            // the copies are abandoned: their memory belongs to the arena
+            growArena();
+            continue;
+        }
+        v.data = a.data();
+        break;
     }
 
     VERIFY(v.size % c_ptrSize == 0, "Unaligned data"); // carefully!!! verify allocates the memory
     VERIFY(v.size * 2 == total, "Unpredictable copy constructor");
 
-    int pCount = v.size / c_ptrSize;
-    int diffIndex = v.size / c_intSize;
+    // the bitmap overwrites the second copy behind the scanned words
+    size_t pCount = v.size / c_ptrSize;
     auto data = PtrArray(v.data);
-    auto diffData = IntArray(v.data);
-    for (int i = 0; i < pCount; ++ i)
+    auto bitmap = (BitmapWord*)(v.data + v.size);
+    BitmapWord word = 0;
+    for (size_t i = 0; i < pCount; ++ i)
     {
-        int diff = data[i + pCount] - data[i];
+        auto diff = data[i + pCount] - data[i];
         if (diff)
         {
-            //LOG("Diff: " << i << ", " << diff << ", " << diffIndex);
-            VERIFY(diff == v.size, "Invalid pointers shift");
+            VERIFY(size_t(diff) == v.size, "Invalid pointers shift: heap allocation outside of arena");
             data[i] -= intptr_t(v.data);
-            diffData[diffIndex ++] = i;
+            word |= BitmapWord(1) << (i % c_bitmapBits);
+        }
+        if (i % c_bitmapBits == c_bitmapBits - 1)
+        {
+            bitmap[i / c_bitmapBits] = word;
+            word = 0;
         }
     }
-    diffData[diffIndex ++] = v.size / c_intSize;
-    v.size = diffIndex * c_intSize;
-    //LOG("diff index created: " << v.size << ", " << diffIndex << ", " << pCount);
+    ImageTrailer trailer{uint32_t(v.size), uint32_t((pCount + c_bitmapBits - 1) / c_bitmapBits)};
+    if (pCount % c_bitmapBits)
+        bitmap[pCount / c_bitmapBits] = word;
+    Ptr end = Ptr(bitmap + trailer.bitmapWords);
+    std::memcpy(end, &trailer, sizeof(trailer));
+    v.size = end + sizeof(trailer) - v.data;
     return v;
 }
 
+}
+
+// TODO: consider using copy interface and hide the implementation
+// need to copy to buffer immediately
+template<typename T>
+View serialize(const T& obj)
+{
+    return detail::serialize(obj, std::is_trivially_copyable<T>());
+}
+
 // changes the buffer, performs in-place transformation
+template<typename T>
+T& deserialize(View v)
+{
+    return *(T*)relocate(v);
+}
+
 template<typename T>
 T& deserialize(Buffer& buf)
 {
-    VERIFY(buf.size() >= c_intSize, "Invalid buffer size: must be >= intSize");
-    VERIFY(buf.size() % c_intSize == 0, "Invalid buffer size: must be aligned");
-    int intCount = buf.size() / c_intSize - 1; // not to include the diff index
-    auto intArray = IntArray(buf.data());
-    auto data = PtrArray(buf.data());
-    int diffIndex = intArray[intCount];
-    VERIFY(diffIndex <= intCount, "Invalid diff index");
-    int dataCount = diffIndex * c_intSize / c_ptrSize;
-    for (int i = diffIndex; i < intCount; ++ i)
-    {
-        int dataIndex = intArray[i];
-        //LOG("Replacing: " << i << ", " << dataIndex);
-        VERIFY(dataIndex < dataCount, "Invalid data index");
-        data[dataIndex] += intptr_t(buf.data());
-    }
-    return *(T*)buf.data();
+    return deserialize<T>(bufToView(buf));
 }
 
 template<typename T>
@@ -111,17 +201,447 @@ void bufInsertPod(Buffer& b, const T& obj)
     bufInsertView(b, podToView(obj));
 }
 
-View bufToView(Buffer& b);
-
 void showBuffer(Buffer& buf);
 
+/*
+ * Trait-based serialization: writes the compact image in a single pass
+ * without pointers and relocations. Supported types: trivially copyable
+ * non-pointer types, std::string, std::vector, std::pair, std::map,
+ * std::set, std::unordered_map, std::unordered_set, boost::optional and
+ * user types with the hook:
+ *
+ *     template<typename V>
+ *     void serializeFields(V& v) { v(a, b, c); }
+ *
+ * Type-erased handlers (AnyMsg) cannot be visited and use the image
+ * serialization above.
+ */
+struct Writer
+{
+    explicit Writer(Buffer& buf);
+
+    void write(const void* p, size_t size);
+
+    template<typename... T>
+    void operator()(const T&... t);
+
+private:
+    Buffer& buf_;
+};
+
+struct Reader
+{
+    explicit Reader(View v);
+
+    void read(void* p, size_t size);
+    bool empty() const;
+    size_t left() const;
+
+    template<typename... T>
+    void operator()(T&... t);
+
+private:
+    View v_;
+};
+
+template<typename T, typename = void>
+struct Serial;
+
+namespace detail {
+
+template<typename T, typename = void>
+struct HasFields : std::false_type {};
+
+template<typename T>
+struct HasFields<T, decltype(std::declval<T&>().serializeFields(std::declval<Writer&>()), void())>
+    : std::true_type {};
+
+template<typename T>
+using IsRaw = std::integral_constant<bool,
+    std::is_trivially_copyable<T>::value && !std::is_pointer<T>::value && !HasFields<T>::value>;
+
+using SizeType = uint32_t;
+
+inline void writeSize(Writer& w, size_t size)
+{
+    VERIFY(size <= std::numeric_limits<SizeType>::max(), "Serial: container is too large");
+    SizeType sz = size;
+    w.write(&sz, sizeof(sz));
+}
+
+inline size_t readSize(Reader& r)
+{
+    SizeType sz;
+    r.read(&sz, sizeof(sz));
+    return sz;
+}
+
+// the corrupted size must fail before the allocation
+inline size_t readSize(Reader& r, size_t elemSize)
+{
+    size_t sz = readSize(r);
+    VERIFY(sz <= r.left() / elemSize, "Serial: unexpected end of data");
+    return sz;
+}
+
+template<typename T>
+void writeRange(Writer& w, const T& t)
+{
+    writeSize(w, t.size());
+    for (auto&& e: t)
+        Serial<typename T::value_type>::write(w, e);
+}
+
+template<typename T>
+void readInsert(Reader& r, T& t)
+{
+    t.clear();
+    size_t sz = readSize(r);
+    for (size_t i = 0; i < sz; ++ i)
+    {
+        typename T::value_type e;
+        Serial<typename T::value_type>::read(r, e);
+        t.insert(std::move(e));
+    }
+}
+
+template<typename T>
+struct SerialMap
+{
+    static void write(Writer& w, const T& t)
+    {
+        writeSize(w, t.size());
+        for (auto&& e: t)
+            w(e.first, e.second);
+    }
+
+    static void read(Reader& r, T& t)
+    {
+        t.clear();
+        size_t sz = readSize(r);
+        for (size_t i = 0; i < sz; ++ i)
+        {
+            typename T::key_type k;
+            typename T::mapped_type v;
+            r(k, v);
+            t.emplace(std::move(k), std::move(v));
+        }
+    }
+};
+
+template<typename T>
+struct SerialSet
+{
+    static void write(Writer& w, const T& t)    { writeRange(w, t); }
+    static void read(Reader& r, T& t)           { readInsert(r, t); }
+};
+
+}
+
+template<typename T>
+struct Serial<T, typename std::enable_if<detail::IsRaw<T>::value>::type>
+{
+    static void write(Writer& w, const T& t)    { w.write(&t, sizeof(T)); }
+    static void read(Reader& r, T& t)           { r.read(&t, sizeof(T)); }
+};
+
+template<typename T>
+struct Serial<T, typename std::enable_if<detail::HasFields<T>::value>::type>
+{
+    // the hook is shared by writer and reader, the writer doesn't modify fields
+    static void write(Writer& w, const T& t)    { const_cast<T&>(t).serializeFields(w); }
+    static void read(Reader& r, T& t)           { t.serializeFields(r); }
+};
+
+template<>
+struct Serial<std::string>
+{
+    static void write(Writer& w, const std::string& t)
+    {
+        detail::writeSize(w, t.size());
+        w.write(t.data(), t.size());
+    }
+
+    static void read(Reader& r, std::string& t)
+    {
+        t.resize(detail::readSize(r, 1));
+        r.read(&t[0], t.size());
+    }
+};
+
+// the handler is carried as image thus valid only between the same
+// binaries, the protocol messages must be registered instead
+template<>
+struct Serial<Handler>
+{
+    static void write(Writer& w, const Handler& t)
+    {
+        View image = serialize(t);
+        detail::writeSize(w, image.size);
+        w.write(image.data, image.size);
+    }
+
+    static void read(Reader& r, Handler& t)
+    {
+        Buffer image(detail::readSize(r, 1));
+        r.read(image.data(), image.size());
+        t = deserialize<Handler>(image); // copies out of the image
+    }
+};
+
+template<typename T, typename A>
+struct Serial<std::vector<T, A>>
+{
+    static void write(Writer& w, const std::vector<T, A>& t)
+    {
+        write(w, t, IsBulk());
+    }
+
+    static void read(Reader& r, std::vector<T, A>& t)
+    {
+        read(r, t, IsBulk());
+    }
+
+private:
+    // vector<bool> is packed and has no data()
+    using IsBulk = std::integral_constant<bool,
+        detail::IsRaw<T>::value && !std::is_same<T, bool>::value>;
+
+    static void write(Writer& w, const std::vector<T, A>& t, std::true_type)
+    {
+        detail::writeSize(w, t.size());
+        w.write(t.data(), t.size() * sizeof(T));
+    }
+
+    static void write(Writer& w, const std::vector<T, A>& t, std::false_type)
+    {
+        detail::writeRange(w, t);
+    }
+
+    static void read(Reader& r, std::vector<T, A>& t, std::true_type)
+    {
+        t.resize(detail::readSize(r, sizeof(T)));
+        r.read(t.data(), t.size() * sizeof(T));
+    }
+
+    // the elements size is unknown: grows as the data is read
+    static void read(Reader& r, std::vector<T, A>& t, std::false_type)
+    {
+        size_t sz = detail::readSize(r);
+        t.clear();
+        t.reserve(std::min(sz, r.left()));
+        for (size_t i = 0; i < sz; ++ i)
+        {
+            T e;
+            Serial<T>::read(r, e);
+            t.push_back(std::move(e));
+        }
+    }
+};
+
+template<typename T1, typename T2>
+struct Serial<std::pair<T1, T2>, typename std::enable_if<!detail::IsRaw<std::pair<T1, T2>>::value>::type>
+{
+    static void write(Writer& w, const std::pair<T1, T2>& t)    { w(t.first, t.second); }
+    static void read(Reader& r, std::pair<T1, T2>& t)           { r(t.first, t.second); }
+};
+
+template<typename T>
+struct Serial<boost::optional<T>, typename std::enable_if<!detail::IsRaw<boost::optional<T>>::value>::type>
+{
+    static void write(Writer& w, const boost::optional<T>& t)
+    {
+        w(bool(t));
+        if (t)
+            w(*t);
+    }
+
+    static void read(Reader& r, boost::optional<T>& t)
+    {
+        bool has;
+        r(has);
+        if (!has)
+        {
+            t.reset();
+            return;
+        }
+        T v;
+        r(v);
+        t = std::move(v);
+    }
+};
+
+template<typename K, typename V, typename C, typename A>
+struct Serial<std::map<K, V, C, A>> : detail::SerialMap<std::map<K, V, C, A>> {};
+
+template<typename K, typename V, typename H, typename E, typename A>
+struct Serial<std::unordered_map<K, V, H, E, A>> : detail::SerialMap<std::unordered_map<K, V, H, E, A>> {};
+
+template<typename T, typename C, typename A>
+struct Serial<std::set<T, C, A>> : detail::SerialSet<std::set<T, C, A>> {};
+
+template<typename T, typename H, typename E, typename A>
+struct Serial<std::unordered_set<T, H, E, A>> : detail::SerialSet<std::unordered_set<T, H, E, A>> {};
+
+template<typename... T>
+void Writer::operator()(const T&... t)
+{
+    int dummy[] = {0, (Serial<T>::write(*this, t), 0)...};
+    (void)dummy;
+}
+
+template<typename... T>
+void Reader::operator()(T&... t)
+{
+    int dummy[] = {0, (Serial<T>::read(*this, t), 0)...};
+    (void)dummy;
+}
+
+// appends the compact image of the value to the buffer
+template<typename T>
+void serializeValue(Buffer& buf, const T& t)
+{
+    Writer w{buf};
+    w(t);
+}
+
+template<typename T>
+T deserializeValue(View v)
+{
+    Reader r{v};
+    T t;
+    r(t);
+    VERIFY(r.empty(), "Serial: trailing data");
+    return t;
+}
+
+using MsgTypeId = uint32_t;
+
+// AnyMsg frames carry the relocatable image of the handler
+constexpr MsgTypeId c_anyMsgType = 0;
+constexpr MsgTypeId c_maxMsgType = 4096;
+
+constexpr size_t c_maxFrameSize = 10 * 1024 * 1024;
+constexpr size_t c_fragmentSize = 256 * 1024;
+// reassembled in memory, larger messages require the stream sink
+constexpr uint64_t c_maxMessageSize = uint64_t(1) << 30;
+// the total of the interleaved messages reassembled by the connection
+constexpr uint64_t c_maxReassembledSize = c_maxMessageSize;
+
+constexpr uint16_t c_protocolVersion = 2;
+
+// packet flags
+constexpr uint16_t c_flagCompressed = 1; // the payload starts with CompressedHeader
+constexpr uint16_t c_flagFragment = 2; // the payload starts with FragmentHeader
+
+// wire protocol: the frame is the header followed by the payload, crc is
+// CRC32C of the header with zero crc and the payload, set on writing
+struct PacketHeader
+{
+    uint32_t size; // payload size
+    MsgTypeId type;
+    uint16_t version = c_protocolVersion;
+    uint16_t flags = 0;
+    uint32_t crc = 0;
+    uint64_t traceId = 0;
+};
+
+// fragments of different streams may interleave with each other and other frames
+struct FragmentHeader
+{
+    uint64_t streamId;
+    uint64_t totalSize;
+    uint64_t offset;
+};
+
+// CRC32C (Castagnoli), chained: crc32c(b, crc32c(a)) == crc32c(a + b)
+uint32_t crc32c(View v, uint32_t crc = 0);
+void sealFrame(PacketHeader& header, std::initializer_list<View> payload);
+bool checkFrame(PacketHeader header, View payload);
+
+namespace detail {
+
+uint32_t crc32cSoftware(View v, uint32_t crc);
+
+}
+
+/*
+ * Registered messages: types with compact id and fields hook, the message
+ * is invoked on receive:
+ *
+ *     struct Vote
+ *     {
+ *         static constexpr MsgTypeId msgType = 1;
+ *         template<typename V> void serializeFields(V& v) { v(term, granted); }
+ *         void operator()();
+ *     };
+ *     REGISTER_MSG(Vote) // in the translation unit linked to the binary
+ *
+ * Frames carry the id instead of code pointers and the receiver rebuilds
+ * the message using the local dispatch table, thus the binaries may
+ * differ (PIE/ASLR). The table is filled on static init and read-only then.
+ */
+using MsgDecode = Handler (*)(View);
+
+bool registerMsgType(MsgTypeId type, MsgDecode decode, const char* name);
+// decoding may run on the other thread than the invocation, see runOnCodec
+Handler decodeMsg(MsgTypeId type, View v);
+void dispatchMsg(MsgTypeId type, View v);
+
+template<typename T>
+Handler decodeMsgType(View v)
+{
+    T msg = deserializeValue<T>(v);
+    return [msg]() mutable {
+        msg();
+    };
+}
+
+template<typename T>
+bool registerMsg(const char* name)
+{
+    return registerMsgType(T::msgType, decodeMsgType<T>, name);
+}
+
+#define MSG_CONCAT_IMPL(D_a, D_b)   D_a##D_b
+#define MSG_CONCAT(D_a, D_b)        MSG_CONCAT_IMPL(D_a, D_b)
+#define REGISTER_MSG(D_type)        static const bool MSG_CONCAT(msgRegistered_, __LINE__) = \
+                                        synca::registerMsg<D_type>(#D_type);
+
+namespace detail {
+
+template<typename T, typename = void>
+struct HasMsgType : std::false_type {};
+
+template<typename T>
+struct HasMsgType<T, decltype(void(T::msgType))> : std::true_type {};
+
+}
+
+template<typename T>
+Buffer serializeValueToPacket(const T& obj, MsgTypeId type)
+{
+    Buffer b;
+    bufInsertPod(b, PacketHeader{0, type});
+    serializeValue(b, obj);
+    uint32_t sz = b.size() - sizeof(PacketHeader);
+    std::memcpy(b.data(), &sz, sizeof(sz));
+    return b;
+}
+
+template<typename T>
+Buffer serializeMsgToPacket(const T& msg)
+{
+    return serializeValueToPacket(msg, T::msgType);
+}
+
 template<typename T>
 Buffer serializeToPacket(T& obj)
 {
     View v = serialize(obj);
     //JLOG("view size: " << v.size);
     Buffer b;
-    bufInsertPod(b, v.size);
+    bufInsertPod(b, PacketHeader{uint32_t(v.size), c_anyMsgType});
     bufInsertView(b, v);
     JLOG("buf size: " << b.size());
     //showBuffer(b);
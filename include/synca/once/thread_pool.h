@@ -33,14 +33,38 @@ struct IService : IObject
     virtual AsioService& asioService() = 0;
 };
 
+// elastic mode is enabled when maxThreads > minThreads
+struct ThreadPoolConfig
+{
+    size_t minThreads = 1;
+    size_t maxThreads = 1;
+    int growDelayUs = 1000;     // grow when a handler was queued longer
+    int idleTimeoutMs = 1000;   // shrink when spare threads were idle longer
+    int spinUs = 0;             // busy poll for new work before parking, 0 to park at once
+};
+
+struct ThreadPoolStats
+{
+    size_t threads;
+    uint64_t delayP50Us;
+    uint64_t delayP90Us;
+    uint64_t delayP99Us;
+    uint64_t spinHits;
+    uint64_t parks;
+};
+
 struct ThreadPool : IScheduler, IService
 {
     ThreadPool(size_t threadCount, const char* name = "");
+    explicit ThreadPool(const ThreadPoolConfig& config, const char* name = "");
     ~ThreadPool();
 
     void schedule(Handler handler) override;
     void wait();
     const char* name() const;
+    size_t threadCount() const;
+    // queue delay percentiles are collected in elastic mode only
+    ThreadPoolStats stats() const;
 
 private:
     AsioService& asioService() override;
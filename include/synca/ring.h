@@ -0,0 +1,223 @@
+/*
+ * Copyright 2015 Grigory Demchenko (aka gridem)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+#include "common.h"
+
+namespace synca {
+
+constexpr size_t c_cacheLineSize = 64;
+
+namespace detail {
+
+inline size_t roundUpPow2(size_t v)
+{
+    size_t r = 1;
+    while (r < v)
+        r <<= 1;
+    return r;
+}
+
+template<typename T>
+struct SequencedCell
+{
+    std::atomic<size_t> seq;
+    T data;
+};
+
+}
+
+/*
+ * Bounded lock-free rings: push/pop never block and return false on full/empty.
+ * T is moved only on success.
+ */
+
+// single producer, single consumer
+template<typename T>
+struct SpscRing
+{
+    explicit SpscRing(size_t capacity)
+        : mask_{detail::roundUpPow2(capacity) - 1}
+        , data_{new T[mask_ + 1]}
+    {
+    }
+
+    bool push(T& t)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - headCache_ > mask_)
+        {
+            headCache_ = head_.load(std::memory_order_acquire);
+            if (tail - headCache_ > mask_)
+                return false;
+        }
+        data_[tail & mask_] = std::move(t);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& t)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tailCache_)
+        {
+            tailCache_ = tail_.load(std::memory_order_acquire);
+            if (head == tailCache_)
+                return false;
+        }
+        t = std::move(data_[head & mask_]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const
+    {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const
+    {
+        return mask_ + 1;
+    }
+
+private:
+    const size_t mask_;
+    std::unique_ptr<T[]> data_;
+    alignas(c_cacheLineSize) std::atomic<size_t> head_ {0};
+    size_t tailCache_ = 0; // consumer side
+    alignas(c_cacheLineSize) std::atomic<size_t> tail_ {0};
+    size_t headCache_ = 0; // producer side
+};
+
+// multiple producers, multiple consumers (D. Vyukov's bounded queue)
+// T_singleConsumer replaces the consumer CAS by a plain store
+template<typename T, bool T_singleConsumer = false>
+struct MpmcRing
+{
+    explicit MpmcRing(size_t capacity)
+        : mask_{detail::roundUpPow2(capacity) - 1}
+        , cells_{new Cell[mask_ + 1]}
+    {
+        for (size_t i = 0; i <= mask_; ++ i)
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    bool push(T& t)
+    {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true)
+        {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = intptr_t(seq) - intptr_t(pos);
+            if (diff == 0)
+            {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = std::move(t);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& t)
+    {
+        size_t pos = head_.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true)
+        {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = intptr_t(seq) - intptr_t(pos + 1);
+            if (diff == 0)
+            {
+                if (T_singleConsumer)
+                {
+                    head_.store(pos + 1, std::memory_order_relaxed);
+                    break;
+                }
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+        t = std::move(cell->data);
+        cell->seq.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const
+    {
+        size_t pos = head_.load(std::memory_order_acquire);
+        size_t seq = cells_[pos & mask_].seq.load(std::memory_order_acquire);
+        return intptr_t(seq) - intptr_t(pos + 1) < 0;
+    }
+
+    size_t capacity() const
+    {
+        return mask_ + 1;
+    }
+
+private:
+    using Cell = detail::SequencedCell<T>;
+
+    const size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+    alignas(c_cacheLineSize) std::atomic<size_t> head_ {0};
+    alignas(c_cacheLineSize) std::atomic<size_t> tail_ {0};
+};
+
+// ring policies to be used as RingChannel parameter
+struct Spsc
+{
+    template<typename T>
+    using Ring = SpscRing<T>;
+};
+
+struct Mpsc
+{
+    template<typename T>
+    using Ring = MpmcRing<T, true>;
+};
+
+struct Mpmc
+{
+    template<typename T>
+    using Ring = MpmcRing<T>;
+};
+
+}
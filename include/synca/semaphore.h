@@ -0,0 +1,98 @@
+/*
+ * Copyright 2015 Grigory Demchenko (aka gridem)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "synca.h"
+
+namespace synca {
+
+enum class Fairness
+{
+    Fifo,       // the waiters are served in arrival order, newcomers wait behind them
+    Barging,    // newcomers and smaller requests may overtake the waiting ones
+};
+
+// counting semaphore for journeys
+struct Semaphore
+{
+    explicit Semaphore(size_t permits, Fairness fairness = Fairness::Fifo);
+    ~Semaphore();
+
+    void acquire(size_t n = 1);
+    bool tryAcquire(size_t n = 1);
+    void release(size_t n = 1);
+    size_t available() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+struct SemaphoreGuard
+{
+    explicit SemaphoreGuard(Semaphore& s, size_t n = 1) : s_(s), n_(n) { s_.acquire(n_); }
+    ~SemaphoreGuard()                                               { s_.release(n_); }
+
+private:
+    Semaphore& s_;
+    size_t n_;
+};
+
+// token bucket: rate tokens per second, up to burst tokens are stored
+// acquire above burst waits for the deficit, tryAcquire above burst fails
+struct RateLimiter
+{
+    RateLimiter(double rate, size_t burst, Fairness fairness = Fairness::Fifo);
+    ~RateLimiter();
+
+    void acquire(size_t n = 1);
+    bool tryAcquire(size_t n = 1);
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+// single use: wait returns once countDown was called count times
+struct Latch
+{
+    explicit Latch(size_t count);
+    ~Latch();
+
+    void countDown(size_t n = 1);
+    void wait();
+    bool tryWait() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+// reusable: arriveAndWait returns once all parties arrived
+struct Barrier
+{
+    explicit Barrier(size_t parties);
+    ~Barrier();
+
+    void arriveAndWait();
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+}
@@ -25,6 +25,10 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <set>
+#include <type_traits>
+#include <limits>
+#include <cstring>
+#include <new>
 
 #include "common.h"
 
@@ -43,6 +47,7 @@
 #include "once/data.h"
 #include "once/connector.h"
 #include "once/listener.h"
-#include "once/node.h"
 #include "once/serialization.h" // TODO: consider move to impl
+#include "once/compression.h"
+#include "once/node.h"
 #include "once/modifiers.h"
@@ -0,0 +1,283 @@
+/*
+ * Copyright 2015 Grigory Demchenko (aka gridem)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "synca_impl.h"
+
+namespace synca {
+
+struct CompressionStat
+{
+    struct Compressed {};
+    struct Skipped {};
+    struct RawBytes {};
+    struct CompressedBytes {};
+    struct CompressUs {};
+    struct Decompressed {};
+    struct DecompressUs {};
+};
+
+namespace {
+
+/*
+ * LZ77 block format (LZ4-like): sequences of
+ *     token: literals length (high nibble), match length - 4 (low nibble)
+ *     [literals length extension: 255, ..., <255]
+ *     literals
+ *     match offset: 2 bytes little endian
+ *     [match length extension: 255, ..., <255]
+ * the last sequence contains literals only.
+ */
+struct LzCodec : ICodec
+{
+    CodecId id() const override
+    {
+        return c_lzCodec;
+    }
+
+    void compress(View src, Buffer& dst) override
+    {
+        std::vector<uint32_t> table(c_tableSize); // position + 1, 0 is empty
+        size_t anchor = 0;
+        size_t i = 0;
+        while (i + c_minMatch <= src.size)
+        {
+            uint32_t seq = load32(src.data + i);
+            uint32_t& entry = table[hash(seq)];
+            size_t candidate = entry;
+            entry = uint32_t(i + 1);
+            if (candidate == 0 || i - (candidate - 1) > c_maxOffset || load32(src.data + candidate - 1) != seq)
+            {
+                ++ i;
+                continue;
+            }
+            size_t match = candidate - 1;
+            size_t len = c_minMatch;
+            while (i + len < src.size && src.data[match + len] == src.data[i + len])
+                ++ len;
+            writeSequence(dst, {src.data + anchor, i - anchor}, i - match, len);
+            i += len;
+            anchor = i;
+        }
+        writeLiterals(dst, {src.data + anchor, src.size - anchor}, 0);
+    }
+
+    void decompress(View src, View dst) override
+    {
+        size_t ip = 0;
+        size_t op = 0;
+        while (true)
+        {
+            VERIFY(ip < src.size, "LZ: unexpected end of data");
+            Byte token = src.data[ip ++];
+            size_t literals = readLength(src, ip, token >> 4);
+            VERIFY(literals <= src.size - ip && literals <= dst.size - op, "LZ: invalid literals length");
+            std::memcpy(dst.data + op, src.data + ip, literals);
+            ip += literals;
+            op += literals;
+            if (ip == src.size)
+                break;
+            VERIFY(src.size - ip >= 2, "LZ: unexpected end of data");
+            size_t offset = src.data[ip] | (size_t(src.data[ip + 1]) << 8);
+            ip += 2;
+            VERIFY(offset > 0 && offset <= op, "LZ: invalid offset");
+            size_t len = readLength(src, ip, token & 0xf) + c_minMatch;
+            VERIFY(len <= dst.size - op, "LZ: invalid match length");
+            Ptr from = dst.data + op - offset;
+            if (offset >= len)
+            {
+                std::memcpy(dst.data + op, from, len);
+            }
+            else
+            {
+                // overlapped match repeats the pattern
+                for (size_t j = 0; j < len; ++ j)
+                    dst.data[op + j] = from[j];
+            }
+            op += len;
+        }
+        VERIFY(op == dst.size, "LZ: invalid raw size");
+    }
+
+private:
+    static constexpr size_t c_minMatch = 4;
+    static constexpr size_t c_maxOffset = 65535;
+    static constexpr size_t c_hashBits = 12;
+    static constexpr size_t c_tableSize = size_t(1) << c_hashBits;
+
+    static uint32_t load32(const Byte* p)
+    {
+        uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static size_t hash(uint32_t seq)
+    {
+        return (seq * 2654435761u) >> (32 - c_hashBits);
+    }
+
+    static void writeLength(Buffer& dst, size_t len)
+    {
+        for (; len >= 255; len -= 255)
+            dst.push_back(255);
+        dst.push_back(Byte(len));
+    }
+
+    static size_t readLength(View src, size_t& ip, size_t nibble)
+    {
+        size_t len = nibble;
+        if (nibble < 15)
+            return len;
+        while (true)
+        {
+            VERIFY(ip < src.size, "LZ: unexpected end of data");
+            Byte b = src.data[ip ++];
+            len += b;
+            if (b != 255)
+                return len;
+        }
+    }
+
+    static void writeLiterals(Buffer& dst, View literals, Byte matchNibble)
+    {
+        dst.push_back(Byte((std::min<size_t>(literals.size, 15) << 4) | matchNibble));
+        if (literals.size >= 15)
+            writeLength(dst, literals.size - 15);
+        bufInsertView(dst, literals);
+    }
+
+    static void writeSequence(Buffer& dst, View literals, size_t offset, size_t len)
+    {
+        size_t matchLen = len - c_minMatch;
+        writeLiterals(dst, literals, Byte(std::min<size_t>(matchLen, 15)));
+        dst.push_back(Byte(offset));
+        dst.push_back(Byte(offset >> 8));
+        if (matchLen >= 15)
+            writeLength(dst, matchLen - 15);
+    }
+};
+
+struct Codecs
+{
+    Codecs()
+    {
+        add(std::make_shared<LzCodec>());
+    }
+
+    void add(std::shared_ptr<ICodec> codec)
+    {
+        VERIFY(codec->id() != c_noCodec, "Invalid codec id");
+        Lock _{mutex_};
+        codecs_[codec->id()] = std::move(codec);
+    }
+
+    std::shared_ptr<ICodec> find(CodecId id)
+    {
+        Lock _{mutex_};
+        auto it = codecs_.find(id);
+        return it == codecs_.end() ? nullptr : it->second;
+    }
+
+private:
+    using Lock = std::unique_lock<std::mutex>;
+
+    std::mutex mutex_;
+    std::unordered_map<CodecId, std::shared_ptr<ICodec>> codecs_;
+};
+
+struct CompressionConfig
+{
+    Atomic<CodecId> codec;
+    Atomic<size_t> threshold {c_compressionThreshold};
+};
+
+}
+
+void registerCodec(std::shared_ptr<ICodec> codec)
+{
+    single<Codecs>().add(std::move(codec));
+}
+
+std::shared_ptr<ICodec> findCodec(CodecId id)
+{
+    return single<Codecs>().find(id);
+}
+
+void setCompression(CodecId codec, size_t threshold)
+{
+    VERIFY(codec == c_noCodec || findCodec(codec), "Unknown codec");
+    auto& config = single<CompressionConfig>();
+    config.threshold.store(threshold, std::memory_order_relaxed);
+    config.codec.store(codec, std::memory_order_relaxed);
+}
+
+Buffer compressPacket(Buffer packet)
+{
+    auto& config = single<CompressionConfig>();
+    CodecId id = config.codec.load(std::memory_order_relaxed);
+    PacketHeader header;
+    VERIFY(packet.size() >= sizeof(header), "Invalid packet size");
+    std::memcpy(&header, packet.data(), sizeof(header));
+    if (id == c_noCodec || (header.flags & c_flagCompressed) || header.size < config.threshold.load(std::memory_order_relaxed))
+        return packet;
+    auto codec = findCodec(id);
+    VERIFY(codec, "Unknown codec");
+
+    Buffer compressed;
+    compressed.reserve(packet.size());
+    PacketHeader compressedHeader = header;
+    compressedHeader.flags |= c_flagCompressed;
+    bufInsertPod(compressed, compressedHeader);
+    bufInsertPod(compressed, CompressedHeader{id, header.size});
+    {
+        ScopedTime<CompressionStat::CompressUs, ThreadCpuClock> _;
+        codec->compress({packet.data() + sizeof(header), header.size}, compressed);
+    }
+    if (compressed.size() >= packet.size())
+    {
+        incStat<CompressionStat::Skipped>();
+        return packet;
+    }
+    uint32_t sz = compressed.size() - sizeof(header);
+    std::memcpy(compressed.data(), &sz, sizeof(sz));
+    incStat<CompressionStat::Compressed>();
+    addStat<CompressionStat::RawBytes>(header.size);
+    addStat<CompressionStat::CompressedBytes>(sz);
+    return compressed;
+}
+
+size_t decompressedSize(View payload)
+{
+    CompressedHeader header;
+    VERIFY(payload.size >= sizeof(header), "Invalid compressed payload");
+    std::memcpy(&header, payload.data, sizeof(header));
+    VERIFY(header.rawSize <= c_maxMessageSize, "Invalid message size");
+    return header.rawSize;
+}
+
+void decompressPayload(View payload, View raw)
+{
+    VERIFY(decompressedSize(payload) == raw.size, "Invalid raw size");
+    CompressedHeader header;
+    std::memcpy(&header, payload.data, sizeof(header));
+    auto codec = findCodec(header.codec);
+    VERIFY(codec, "Unknown codec");
+    ScopedTime<CompressionStat::DecompressUs, ThreadCpuClock> _;
+    codec->decompress({payload.data + sizeof(header), payload.size - sizeof(header)}, raw);
+    incStat<CompressionStat::Decompressed>();
+}
+
+}
@@ -38,20 +38,30 @@ Connector::~Connector()
 }
 
 void Connector::write(View view)
+{
+    tryWrite(view).value<ConnectorError>();
+}
+
+void Connector::write(std::initializer_list<View> views)
+{
+    tryWrite(views).value<ConnectorError>();
+}
+
+Result<> Connector::tryWrite(View view)
 {
     incStat<ConnectorStat::Write>();
     Lock _{write_};
-    performOp([&] {
-        socket_.write(view);
+    return tryPerformOp([&] {
+        return socket_.tryWrite(view);
     });
 }
 
-void Connector::write(std::initializer_list<View> views)
+Result<> Connector::tryWrite(std::initializer_list<View> views)
 {
     incStat<ConnectorStat::WriteList>();
     Lock _{write_};
-    performOp([&] {
-        socket_.write(views);
+    return tryPerformOp([&] {
+        return socket_.tryWrite(views);
     });
 }
 
@@ -65,17 +75,20 @@ void Connector::disconnect()
     socket_.close();
 }
 
-void Connector::reconnect()
+Result<> Connector::tryReconnect()
 {
     incStat<ConnectorStat::Reconnect>();
-    networkRetry([&] {
+    while (true)
+    {
         //if (disconnected_.load(std::memory_order_relaxed))
         if (disconnected_)
-            throw ConnectorError("Disconnected");
-        socket_.connect(endpoint_);
-    }, [&] {
+            return {Status::Failed, "Disconnected"};
+        Result<> r = socket_.tryConnect(endpoint_);
+        if (r.status() != Status::Failed)
+            return r;
+        JLOG("retrying on: " << r.error());
         incStat<ConnectorStat::ConnectRetry>();
-    });
+    }
 }
 
 }
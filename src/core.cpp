@@ -33,6 +33,27 @@ Goer go(Handler handler)
     return Journey::start(std::move(handler), scheduler<DefaultTag>());
 }
 
+void post(Handler handler, IScheduler& scheduler)
+{
+    scheduler.schedule([handler] {
+        Task task;
+        auto _ = tlsGuard(&task);
+        try
+        {
+            handler();
+        }
+        catch (std::exception& e)
+        {
+            RLOG("exception in task: " << e.what());
+        }
+    });
+}
+
+void post(Handler handler)
+{
+    post(std::move(handler), scheduler<DefaultTag>());
+}
+
 void goN(int n, Handler h)
 {
     go(n == 1 ? h : [n, h] {
@@ -81,6 +102,11 @@ void waitForDone()
     journey().waitForDone();
 }
 
+Status tryWaitForDone()
+{
+    return journey().tryWaitForDone();
+}
+
 void goWait(std::initializer_list<Handler> handlers)
 {
     deferProceed([&handlers](Handler proceed) {
@@ -187,6 +213,125 @@ size_t goAnyWait(std::initializer_list<Handler> handlers)
     return index;
 }
 
+namespace detail {
+
+void FirstState::start()
+{
+    Lock _{mutex_};
+    ++ running_;
+}
+
+bool FirstState::hasWinner() const
+{
+    Lock _{mutex_};
+    return winner_ != c_none;
+}
+
+bool FirstState::tryWin(size_t index)
+{
+    Lock _{mutex_};
+    if (winner_ != c_none)
+        return false;
+    winner_ = index;
+    return true;
+}
+
+void FirstState::finish(bool won)
+{
+    boost::optional<DetachableDoer> waiter;
+    {
+        Lock _{mutex_};
+        -- running_;
+        if (won)
+            winnerDone_ = true;
+        if (ready0())
+            waiter.swap(waiter_);
+    }
+    // the state may be gone here
+    if (waiter)
+        waiter->done();
+}
+
+Status FirstState::waitReady()
+{
+    Lock lock{mutex_};
+    while (!ready0())
+    {
+        wait0(lock);
+        Status status = tryWaitForDone();
+        lock.lock();
+        if (status != Status::Ok)
+        {
+            // stale waiter cannot acquire the doer after the event
+            waiter_.reset();
+            return status;
+        }
+    }
+    return Status::Ok;
+}
+
+void FirstState::drain()
+{
+    DtorEventsGuard _;
+    Lock lock{mutex_};
+    while (running_ != 0)
+    {
+        wait0(lock);
+        waitForDone();
+        lock.lock();
+    }
+}
+
+bool FirstState::ready0() const
+{
+    return winnerDone_ || running_ == 0;
+}
+
+void FirstState::wait0(Lock& lock)
+{
+    waiter_ = DetachableDoer{};
+    lock.unlock();
+}
+
+void goFirst(size_t n, int hedgeMs, const FirstRun& run)
+{
+    VERIFY(n >= 1, "Handlers amount must be positive");
+
+    FirstState state;
+    std::vector<Goer> goers;
+    goers.reserve(n);
+    for (size_t i = 0; i < n; ++ i)
+    {
+        state.start();
+        goers.push_back(go([&state, &run, i, hedgeMs] {
+            bool won = false;
+            try
+            {
+                if (i != 0 && hedgeMs > 0)
+                    sleepa(int(i) * hedgeMs);
+                if (!state.hasWinner())
+                    won = run(i, state);
+            }
+            catch (Event&)
+            {
+                JLOG("goFirst: loser cancelled: " << i);
+            }
+            catch (std::exception& e)
+            {
+                logException(e);
+            }
+            state.finish(won);
+        }));
+    }
+    Status status = state.waitReady();
+    for (auto&& g: goers)
+        g.cancel();
+    state.drain();
+    raise(status);
+}
+
+}
+
 struct Alone::Impl : boost::asio::io_service::strand
 {
     using boost::asio::io_service::strand::strand;
@@ -243,6 +388,59 @@ void sleepa(int ms)
     waitForDone();
 }
 
+struct SelectAfter::Impl : boost::asio::deadline_timer
+{
+    using boost::asio::deadline_timer::deadline_timer;
+};
+
+SelectAfter::SelectAfter(int ms)
+    : ms_{ms}
+{
+}
+
+SelectAfter::SelectAfter(SelectAfter&&) = default;
+
+SelectAfter::~SelectAfter()
+{
+    if (impl_)
+        impl_->cancel();
+}
+
+void SelectAfter::stop()
+{
+    if (impl_)
+        impl_->cancel();
+}
+
+SelectStart SelectEnded::start(const SelectClaim& claim)
+{
+    DetachableDoer doer;
+    id_ = goer_.onEnded([claim, doer]() mutable {
+        if (claim.claim())
+            doer.done();
+    });
+    if (id_ != 0)
+        return SelectStart::Waiting;
+    return claim.claim() ? SelectStart::Selected : SelectStart::Lost;
+}
+
+void SelectEnded::stop()
+{
+    if (id_ != 0)
+        goer_.removeEnded(id_);
+}
+
+SelectStart SelectAfter::start(const SelectClaim& claim)
+{
+    impl_.reset(new Impl(service<TimeoutTag>(), boost::posix_time::milliseconds(ms_)));
+    DetachableDoer doer;
+    impl_->async_wait([claim, doer](const ErrorCode& error) mutable {
+        if (!error && claim.claim())
+            doer.done();
+    });
+    return SelectStart::Waiting;
+}
+
 void Service::attach(IService& s)
 {
     service = &s.asioService();
@@ -269,6 +467,11 @@ void Scheduler::detach()
     scheduler = nullptr;
 }
 
+bool Scheduler::attached() const
+{
+    return scheduler != nullptr;
+}
+
 Scheduler::operator IScheduler&() const
 {
     VERIFY(scheduler != nullptr, "Scheduler is not attached");
@@ -19,7 +19,6 @@ namespace coro {
  * TODO: coro: remove exceptions saving, remove try
  * TODO: mark non exception functions as noexcept to guarantee features
  * TODO: add creating without start: only resume starts: single point of start
- * TODO: add listener<...> = channel<variant<...>>
  */
 
 // coroutine class
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2015 Grigory Demchenko (aka gridem)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "synca_impl.h"
+
+#if defined(flagGCC_LIKE) && defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+namespace synca {
+
+namespace {
+
+constexpr uint32_t c_crc32cPoly = 0x82f63b78; // reversed Castagnoli polynomial
+
+struct Crc32cTable
+{
+    Crc32cTable()
+    {
+        for (uint32_t i = 0; i < 256; ++ i)
+        {
+            uint32_t c = i;
+            for (int j = 0; j < 8; ++ j)
+                c = (c >> 1) ^ (c & 1 ? c_crc32cPoly : 0);
+            table[i] = c;
+        }
+    }
+
+    uint32_t table[256];
+};
+
+using Crc32cFn = uint32_t (*)(View v, uint32_t crc);
+
+#if defined(flagGCC_LIKE) && defined(__x86_64__)
+__attribute__((target("sse4.2")))
+uint32_t crc32cHardware(View v, uint32_t crc)
+{
+    uint64_t c = ~crc;
+    const Byte* p = v.data;
+    size_t n = v.size;
+    for (; n >= sizeof(uint64_t); n -= sizeof(uint64_t), p += sizeof(uint64_t))
+    {
+        uint64_t word;
+        std::memcpy(&word, p, sizeof(word));
+        c = _mm_crc32_u64(c, word);
+    }
+    uint32_t c32 = uint32_t(c);
+    for (; n > 0; -- n, ++ p)
+        c32 = _mm_crc32_u8(c32, *p);
+    return ~c32;
+}
+
+Crc32cFn selectCrc32c()
+{
+    return __builtin_cpu_supports("sse4.2") ? crc32cHardware : detail::crc32cSoftware;
+}
+#else
+Crc32cFn selectCrc32c()
+{
+    return detail::crc32cSoftware;
+}
+#endif
+
+const Crc32cFn c_crc32c = selectCrc32c();
+
+}
+
+uint32_t detail::crc32cSoftware(View v, uint32_t crc)
+{
+    static const Crc32cTable t;
+    uint32_t c = ~crc;
+    for (size_t i = 0; i < v.size; ++ i)
+        c = t.table[(c ^ v.data[i]) & 0xff] ^ (c >> 8);
+    return ~c;
+}
+
+uint32_t crc32c(View v, uint32_t crc)
+{
+    return c_crc32c(v, crc);
+}
+
+void sealFrame(PacketHeader& header, std::initializer_list<View> payload)
+{
+    header.crc = 0;
+    uint32_t crc = crc32c(podToView(header));
+    for (auto&& v: payload)
+        crc = crc32c(v, crc);
+    header.crc = crc;
+}
+
+bool checkFrame(PacketHeader header, View payload)
+{
+    uint32_t crc = header.crc;
+    header.crc = 0;
+    return crc32c(payload, crc32c(podToView(header))) == crc;
+}
+
+}
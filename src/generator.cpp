@@ -0,0 +1,89 @@
+/*
+ * Copyright 2015 Grigory Demchenko (aka gridem)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <synca/generator.h>
+
+#include "synca_impl.h"
+
+namespace synca {
+namespace detail {
+
+namespace {
+
+// unwinds producer stack on destruction of unfinished generator
+struct GeneratorStop {};
+
+}
+
+struct GeneratorBase::Impl
+{
+    explicit Impl(Handler producer)
+        : coro{[this, producer] {
+            try
+            {
+                if (!stopping)
+                    producer();
+            }
+            catch (GeneratorStop&)
+            {
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+        }}
+    {
+    }
+
+    coro::Coro coro;
+    std::exception_ptr error;
+    bool stopping = false;
+};
+
+GeneratorBase::GeneratorBase(Handler producer)
+    : impl_{new Impl(std::move(producer))}
+{
+}
+
+GeneratorBase::~GeneratorBase()
+{
+    if (impl_->coro.isCompleted())
+        return;
+    // not started producer just completes, started one unwinds from yield
+    impl_->stopping = true;
+    impl_->coro.resume();
+}
+
+bool GeneratorBase::resume()
+{
+    if (impl_->coro.isCompleted())
+        return false;
+    if (!impl_->coro.resume())
+        return true;
+    if (impl_->error)
+        std::rethrow_exception(std::exchange(impl_->error, nullptr));
+    return false;
+}
+
+void GeneratorBase::yield()
+{
+    impl_->coro.yield();
+    if (impl_->stopping)
+        throw GeneratorStop{};
+}
+
+}
+}
@@ -64,6 +64,37 @@ void JourneyState::timedout()
     addRaiseEvent(FlagTimedout);
 }
 
+size_t JourneyState::onEnded(Handler handler)
+{
+    std::unique_lock<std::mutex> _{endedMutex_};
+    if (ended_)
+        return 0;
+    endedHandlers_.emplace_back(++ lastEndedId_, std::move(handler));
+    return lastEndedId_;
+}
+
+void JourneyState::removeEnded(size_t id)
+{
+    std::unique_lock<std::mutex> _{endedMutex_};
+    auto it = std::find_if(endedHandlers_.begin(), endedHandlers_.end(), [id](const std::pair<size_t, Handler>& h) {
+        return h.first == id;
+    });
+    if (it != endedHandlers_.end())
+        endedHandlers_.erase(it);
+}
+
+void JourneyState::ended()
+{
+    std::vector<std::pair<size_t, Handler>> handlers;
+    {
+        std::unique_lock<std::mutex> _{endedMutex_};
+        ended_ = true;
+        handlers.swap(endedHandlers_);
+    }
+    for (auto&& h: handlers)
+        h.second();
+}
+
 bool JourneyState::disableEvents()
 {
     return (resetFlags0(FlagEventsEnabled) & FlagEventsEnabled) != 0;
@@ -97,20 +128,28 @@ void JourneyState::done()
 }
 
 void JourneyState::handleEvents()
+{
+    raise(tryHandleEvents());
+}
+
+Status JourneyState::tryHandleEvents()
 {
     int event = state_.load(std::memory_order_relaxed);
     if (event & FlagEventsEnabled)
     {
         VERIFY((event & (FlagCancelled | FlagTimedout | FlagDone)) != 0,
                "Must have event");
-        handleRaiseEvents(event);
-        // goes to FlagDone resetting on exception absence
+        Status status = takeEvents(event);
+        if (status != Status::Ok)
+            return status;
+        // goes to FlagDone resetting on event absence
     }
     else
     {
         VERIFY((event & FlagDone) != 0, "Must be done");
     }
     resetFlags0(FlagDone);
+    return Status::Ok;
 }
 
 void JourneyState::resetEnteredAndCheckEvents()
@@ -201,22 +240,29 @@ bool JourneyState::isEventsEnabled()
 }
 
 void JourneyState::handleRaiseEvents(int eventFlag)
+{
+    raise(takeEvents(eventFlag));
+}
+
+// resets the flags of the taken event
+Status JourneyState::takeEvents(int eventFlag)
 {
     if (eventFlag & FlagCancelled)
     {
         // cancel has more priority and resets timeout event
         resetFlags0(FlagCancelled | FlagTimedout | FlagDone);
-        GLOG("throwing event: cancel");
+        GLOG("taking event: cancel");
         incStat<JourneyStat::RaiseCancelEvent>();
-        throw CancelledEvent();
+        return Status::Cancelled;
     }
     if (eventFlag & FlagTimedout)
     {
         resetFlags0(FlagTimedout | FlagDone);
-        GLOG("throwing event: timeout");
+        GLOG("taking event: timeout");
         incStat<JourneyStat::RaiseTimeoutEvent>();
-        throw TimedoutEvent();
+        return Status::Timedout;
     }
+    return Status::Ok;
 }
 
 void JourneyState::addRaiseEvent(int eventFlag)
@@ -341,6 +387,7 @@ Handler Journey::coroHandler(Handler handler)
             RJLOG("exception in coro: " << e.what());
         }
         JJLOG("ended");
+        state_->ended();
     };
 }
 
@@ -383,6 +430,11 @@ void Journey::teleport(IScheduler& s)
 }
 
 void Journey::waitForDone()
+{
+    raise(tryWaitForDone());
+}
+
+Status Journey::tryWaitForDone()
 {
     if (state_->isDone())
     {
@@ -393,7 +445,7 @@ void Journey::waitForDone()
     {
         suspend();
     }
-    handleEvents();
+    return state_->tryHandleEvents();
 }
 
 void Journey::waitForDoneAlways(ICancel &cancel)
@@ -473,6 +525,11 @@ GC &Journey::gc()
     return gc_;
 }
 
+uint64_t& Journey::traceId()
+{
+    return traceId_;
+}
+
 int Journey::index() const
 {
     return indx;
@@ -500,7 +557,12 @@ Goer Journey::start(Handler handler, IScheduler& s)
      * 1. exception safety guarantee
      * 2. goer must be returned before starting to avoid races
      */
-    return (new Journey(std::move(handler), s))->start0();
+    Journey* j = new Journey(std::move(handler), s);
+    // the spawned journey continues the trace of the parent
+    Journey* parent = tlsPtr<Journey>();
+    if (parent != nullptr)
+        j->traceId_ = parent->traceId_;
+    return j->start0();
 }
 
 Goer Journey::start0()
@@ -553,6 +615,11 @@ void Journey::suspend()
 
 Journey& journey()
 {
+#ifndef NDEBUG
+    // debug only: explains the misuse instead of the generic tls error
+    VERIFY(tlsPtr<Journey>() != nullptr || tlsPtr<Task>() == nullptr,
+           "Task must not wait or use journey, use go instead");
+#endif
     return tls<Journey>();
 }
 
@@ -71,14 +71,20 @@ struct JourneyState
     bool isEventsEnabled();
     void done();
     void handleEvents();
+    Status tryHandleEvents();
     void resetEnteredAndCheckEvents();
     bool acquire(int oldCounter, bool wasEventsEnabled);
     void releaseAndDone(bool wasEventsEnabled);
     void detachDoers();
     int counter();
+    // returns 0 if the journey has ended already, the handler is dropped then
+    size_t onEnded(Handler handler);
+    void removeEnded(size_t id);
+    void ended();
 
 private:
     void handleRaiseEvents(int eventFlag);
+    Status takeEvents(int eventFlag);
     void addRaiseEvent(int eventFlag);
     int resetFlags0(int flags);
     int setFlags0(int flags);
@@ -91,6 +97,10 @@ private:
     Atomic<int> state_ {FlagEntered | FlagEventsEnabled/* | FlagDone*/}; // FlagDone MUST be used only if handleEvents before handler
     Journey& j_;
     int index_; // to avoid races when we try to send an event and put logs, TODO: consider removing
+    std::mutex endedMutex_;
+    std::vector<std::pair<size_t, Handler>> endedHandlers_;
+    size_t lastEndedId_ = 0;
+    bool ended_ = false;
 };
 
 // TODO: journey cannot be used together WithCleanup because it doesn't remove deleted instances
@@ -101,6 +111,7 @@ struct Journey : InstanceStat<Journey>//, WithCleanup// : IProceed
     void deferProceed(ProceedHandler proceed);
     void teleport(IScheduler& s);
     void waitForDone();
+    Status tryWaitForDone();
     void waitForDoneAlways(ICancel& cancel); // TODO: consider to move cancellation to destructor of caller
     void waitForDoneAlwaysGuarded(ICancel& cancel);
     void reschedule();
@@ -113,6 +124,7 @@ struct Journey : InstanceStat<Journey>//, WithCleanup// : IProceed
 
     IScheduler& scheduler() const;
     GC& gc();
+    uint64_t& traceId(); // 0 if the journey isn't traced
     int index() const;
     Goer goer() const;
     Doer doer() const;
@@ -141,6 +153,12 @@ private:
 
     // TODO: consider using cls: coro local storage
     GC gc_;
+    uint64_t traceId_ = 0;
+};
+
+// marks the handler run by post: it has no journey and must not wait
+struct Task
+{
 };
 
 Journey& journey();
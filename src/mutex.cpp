@@ -24,49 +24,129 @@ namespace synca
 
 struct MutexStat
 {
-    struct Lock {};
-    struct LockNoWait {};
+    struct LockSpin {};
     struct LockWait {};
-    struct Unlock {};
+    struct LockWaitCancelled {};
     struct UnlockAcquired {};
     struct UnlockNotAcquired {};
-    struct UnlockNoWaiters {};
 };
 
+struct SharedMutexStat
+{
+    struct LockWait {};
+    struct LockSharedWait {};
+    struct LockWaitCancelled {};
+    struct WakeReaders {};
+};
+
+/*
+ * Uncontended lock/unlock is a single CAS on state_.
+ * Waiters are linked intrusively through the nodes placed on the stacks
+ * of their suspended journeys. mutex_ guards the list only and is taken
+ * on the contended path. Unlock with waiters hands the ownership
+ * directly to the first waiter which acquires its doer.
+ */
 struct Mutex::Impl
 {
+    enum
+    {
+        FlagLocked = 1 << 0,
+        FlagWaiters = 1 << 1, // set and reset under mutex_ only
+    };
+
+    explicit Impl(int spinCount)
+        : spinCount_{spinCount}
+    {
+    }
+
     void lock()
     {
-        incStat<MutexStat::Lock>();
         MLOG("lock");
+        if (tryLock0())
+            return;
+        for (int i = 0; i < spinCount_; ++ i)
         {
-            Lock _{mutex_};
-            if (!acquired_)
+            cpuRelax();
+            if (tryLock0())
             {
-                MLOG("acquired");
-                acquired_ = true;
-                incStat<MutexStat::LockNoWait>();
+                incStat<MutexStat::LockSpin>();
                 return;
             }
+        }
+        lockSlow();
+    }
+
+    void unlock()
+    {
+        MLOG("unlock");
+        int s = FlagLocked;
+        if (state_.compare_exchange_strong(s, 0, std::memory_order_release, std::memory_order_relaxed))
+            return;
+        unlockSlow();
+    }
+
+private:
+    bool tryLock0()
+    {
+        int s = state_.load(std::memory_order_relaxed);
+        return (s & FlagLocked) == 0 && state_.compare_exchange_strong(
+            s, s | FlagLocked, std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+    void lockSlow()
+    {
+        WaitNode node{DetachableDoer{}};
+        {
+            Lock _{mutex_};
+            int s = state_.load(std::memory_order_relaxed);
+            while (true)
+            {
+                if ((s & FlagLocked) == 0)
+                {
+                    if (state_.compare_exchange_weak(s, s | FlagLocked, std::memory_order_acquire, std::memory_order_relaxed))
+                    {
+                        MLOG("acquired");
+                        return;
+                    }
+                }
+                else if (state_.compare_exchange_weak(s, s | FlagWaiters, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
             MLOG("wait");
             incStat<MutexStat::LockWait>();
-            doers_.push(DetachableDoer{});
+            waiters_.push(node);
+        }
+        try
+        {
+            waitForDone();
+        }
+        catch (...)
+        {
+            Lock _{mutex_};
+            if (node.linked)
+            {
+                incStat<MutexStat::LockWaitCancelled>();
+                remove0(node);
+            }
+            throw;
         }
-        waitForDone();
         MLOG("wait done");
     }
 
-    void unlock()
+    void unlockSlow()
     {
-        incStat<MutexStat::Unlock>();
-        MLOG("unlock");
         Lock _{mutex_};
-        while (!doers_.empty())
+        while (!waiters_.empty())
         {
             MLOG("unlock nonempty queue");
-            DetachableDoer d = doers_.pop();
-            if (d.acquire())
+            WaitNode& node = waiters_.front();
+            remove0(node);
+            if (node.doer.acquire())
             {
+                // the node may be gone after unlock: the journey is resumed
+                DetachableDoer d = std::move(node.doer);
                 _.unlock();
                 MLOG("unlock acquired");
                 incStat<MutexStat::UnlockAcquired>();
@@ -77,20 +157,32 @@ struct Mutex::Impl
             incStat<MutexStat::UnlockNotAcquired>();
         }
         MLOG("unlock no waiters");
-        incStat<MutexStat::UnlockNoWaiters>();
-        acquired_ = false;
+        state_.store(0, std::memory_order_release);
+    }
+
+    // keeps FlagLocked, resets FlagWaiters on the last waiter
+    void remove0(WaitNode& node)
+    {
+        waiters_.remove(node);
+        if (waiters_.empty())
+            state_.fetch_and(~FlagWaiters, std::memory_order_relaxed);
     }
 
     int index_ = ++ atomic<struct Index>();
+    const int spinCount_;
+    Atomic<int> state_;
     mutable std::mutex mutex_;
-    bool acquired_ = false;
-    Queue<DetachableDoer> doers_;
+    WaitList waiters_;
 };
 
 Mutex::Mutex()
-    : impl_{std::make_unique<Impl>()}
+    : Mutex{0}
 {
+}
 
+Mutex::Mutex(int spinCount)
+    : impl_{std::make_unique<Impl>(spinCount)}
+{
 }
 
 Mutex::~Mutex()
@@ -108,4 +200,152 @@ void Mutex::unlock()
     impl_->unlock();
 }
 
+/*
+ * Writer preference: new readers wait while a writer holds or waits for
+ * the lock. Releasing the lock without waiting writers wakes all waiting
+ * readers at once.
+ */
+struct SharedMutex::Impl
+{
+    using Doers = std::vector<DetachableDoer>;
+
+    void lock()
+    {
+        WaitNode node{DetachableDoer{}};
+        {
+            Lock _{mutex_};
+            if (!writer_ && readers_ == 0)
+            {
+                writer_ = true;
+                return;
+            }
+            incStat<SharedMutexStat::LockWait>();
+            writers_.push(node);
+        }
+        wait0(node, writers_);
+    }
+
+    void unlock()
+    {
+        Doers doers;
+        {
+            Lock _{mutex_};
+            writer_ = false;
+            handOff0(doers);
+        }
+        release0(doers);
+    }
+
+    void lockShared()
+    {
+        WaitNode node{DetachableDoer{}};
+        {
+            Lock _{mutex_};
+            if (!writer_ && writers_.empty())
+            {
+                ++ readers_;
+                return;
+            }
+            incStat<SharedMutexStat::LockSharedWait>();
+            waitingReaders_.push(node);
+        }
+        wait0(node, waitingReaders_);
+    }
+
+    void unlockShared()
+    {
+        Doers doers;
+        {
+            Lock _{mutex_};
+            if (-- readers_ == 0)
+                handOff0(doers);
+        }
+        release0(doers);
+    }
+
+private:
+    void wait0(WaitNode& node, WaitList& list)
+    {
+        try
+        {
+            waitForDone();
+        }
+        catch (...)
+        {
+            Doers doers;
+            {
+                Lock _{mutex_};
+                if (node.linked)
+                {
+                    incStat<SharedMutexStat::LockWaitCancelled>();
+                    list.remove(node);
+                    // readers may be waiting for the writer which has gone
+                    if (!writer_ && readers_ == 0)
+                        handOff0(doers);
+                }
+            }
+            release0(doers);
+            throw;
+        }
+    }
+
+    // the lock is free: passes it to a writer or to all waiting readers
+    void handOff0(Doers& doers)
+    {
+        if (auto writer = writers_.popAcquired())
+        {
+            writer_ = true;
+            doers.push_back(std::move(*writer));
+            return;
+        }
+        while (auto reader = waitingReaders_.popAcquired())
+            doers.push_back(std::move(*reader));
+        readers_ += doers.size();
+        if (!doers.empty())
+            incStat<SharedMutexStat::WakeReaders>();
+    }
+
+    // outside of the guard: the journeys are resumed
+    static void release0(Doers& doers)
+    {
+        for (auto&& d: doers)
+            d.releaseAndDone();
+    }
+
+    mutable std::mutex mutex_;
+    bool writer_ = false;
+    size_t readers_ = 0;
+    WaitList writers_;
+    WaitList waitingReaders_;
+};
+
+SharedMutex::SharedMutex()
+    : impl_{std::make_unique<Impl>()}
+{
+}
+
+SharedMutex::~SharedMutex()
+{
+}
+
+void SharedMutex::lock()
+{
+    impl_->lock();
+}
+
+void SharedMutex::unlock()
+{
+    impl_->unlock();
+}
+
+void SharedMutex::lock_shared()
+{
+    impl_->lockShared();
+}
+
+void SharedMutex::unlock_shared()
+{
+    impl_->unlockShared();
+}
+
 }
@@ -31,9 +31,9 @@ DECL_ADAPTER(synca::Resolver::Impl, resolve)
 
 namespace synca {
 
-NetworkError codeToError(const ErrorCode& e)
+std::string codeToMessage(const ErrorCode& e)
 {
-    return NetworkError{boost::system::system_error(e).what()};
+    return boost::system::system_error(e).what();
 }
 
 auto toBuf(View view)
@@ -80,6 +80,11 @@ struct CloseOnError
         waitForDone();
     }
 
+    Status tryWait()
+    {
+        return tryWaitForDone();
+    }
+
     void done()
     {
         wasDone_ = true; //FIXME: race here
@@ -97,12 +102,13 @@ private:
     Doer doer_;
 };
 
+// reports events and errors as Result
 template<typename T_socket, typename T_type = size_t, typename T_close = CloseOp>
-struct BaseSocket : T_socket
+struct BaseTrySocket : T_socket
 {
 protected:
     template<typename F, typename... V>
-    T_type call(F f, V&&... v)
+    Result<T_type> call(F f, V&&... v)
     {
         ErrorCode e;
         T_type val;
@@ -112,22 +118,36 @@ protected:
             val = value;
             closer.done();
         });
-        closer.wait();
+        Status status = closer.tryWait();
+        if (status != Status::Ok)
+            return status;
         if (e)
         {
             closer.close();
-            throw codeToError(e);
+            return {Status::Failed, codeToMessage(e)};
         }
         return val;
     }
 };
 
+template<typename T_socket, typename T_type = size_t, typename T_close = CloseOp>
+struct BaseSocket : BaseTrySocket<T_socket, T_type, T_close>
+{
+protected:
+    template<typename F, typename... V>
+    T_type call(F f, V&&... v)
+    {
+        return BaseTrySocket<T_socket, T_type, T_close>::call(
+            f, std::forward<V>(v)...).template value<NetworkError>();
+    }
+};
+
 template<typename T_socket>
-struct BaseAsio : T_socket
+struct BaseTryAsio : T_socket
 {
 protected:
     template<typename... V, typename F>
-    void call(F f, V&&... v)
+    Result<> call(F f, V&&... v)
     {
         ErrorCode e;
         CloseOnError<T_socket> closer{*this};
@@ -135,12 +155,26 @@ protected:
             e = error;
             closer.done();
         });
-        closer.wait();
+        Status status = closer.tryWait();
+        if (status != Status::Ok)
+            return status;
         if (e)
         {
             closer.close();
-            throw codeToError(e);
+            return {Status::Failed, codeToMessage(e)};
         }
+        return {};
+    }
+};
+
+template<typename T_socket>
+struct BaseAsio : BaseTryAsio<T_socket>
+{
+protected:
+    template<typename... V, typename F>
+    void call(F f, V&&... v)
+    {
+        BaseTryAsio<T_socket>::call(f, std::forward<V>(v)...).template value<NetworkError>();
     }
 };
 
@@ -196,6 +230,16 @@ struct Socket::Impl : boost::asio::ip::tcp::socket, InstanceStat<Socket>
     {
         return adapt<BaseAsio<Socket::Impl>>(*this);
     }
+
+    auto& ioTryOp()
+    {
+        return adapt<BaseTrySocket<Socket::Impl>>(*this);
+    }
+
+    auto& tryOp()
+    {
+        return adapt<BaseTryAsio<Socket::Impl>>(*this);
+    }
 };
 
 Socket::Socket() : socket{std::make_shared<Impl>(service<NetworkTag>())} {}
@@ -225,6 +269,31 @@ void Socket::connect(const Endpoint& e)
     socket->op().connect(e);
 }
 
+Result<> Socket::tryRead(View view)
+{
+    return Result<>{socket->ioTryOp().read(view)};
+}
+
+Result<size_t> Socket::tryPartialRead(View view)
+{
+    return socket->ioTryOp().partialRead(view);
+}
+
+Result<> Socket::tryWrite(View view)
+{
+    return Result<>{socket->ioTryOp().write(view)};
+}
+
+Result<> Socket::tryWrite(std::initializer_list<View> views)
+{
+    return Result<>{socket->ioTryOp().write(views)};
+}
+
+Result<> Socket::tryConnect(const Endpoint& e)
+{
+    return socket->tryOp().connect(e);
+}
+
 void Socket::close()
 {
     //socket->shutdown(boost::asio::ip::tcp::socket::shutdown_both);
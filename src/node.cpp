@@ -14,10 +14,19 @@
  * limitations under the License.
  */
 
+#include <deque>
+
 #include "synca_impl.h"
 
 namespace synca {
 
+struct NodeStat
+{
+    struct PoolHit {};
+    struct PoolMiss {};
+    struct PoolBypass {};
+};
+
 void NodesConfig::addNode(NodeId id, Endpoint e)
 {
     nodes_.insert({id, e});
@@ -93,7 +102,30 @@ void Nodes::send(NodeId id, View view)
     showBuffer(buf);
     get(id)->write(bufToView(buf));
     */
-    get(id)->write(view);
+    auto connector = get(id);
+    // each frame is written under the connector lock separately,
+    // thus the fragments interleave with the frames of the other writers
+    writePacket([&connector](std::initializer_list<View> views) {
+        connector->write(views);
+    }, view);
+}
+
+void Nodes::writeFrame(NodeId id, std::initializer_list<View> frame)
+{
+    get(id)->write(frame);
+}
+
+void Nodes::checkConnected(NodeId id)
+{
+    get(id);
+}
+
+void Nodes::sendStream(NodeId id, MsgTypeId type, uint64_t totalSize, const StreamSource& source)
+{
+    auto connector = get(id);
+    writeStream([&connector](std::initializer_list<View> views) {
+        connector->write(views);
+    }, type, totalSize, source);
 }
 
 bool Nodes::remove(NodeId id)
@@ -142,6 +174,611 @@ Nodes::SharedConnector Nodes::get(NodeId id)
     return it->second;
 }
 
+namespace {
+
+// per connection receive buffers: power of two size classes with
+// uninitialized memory, the buffers are reused without zeroing
+struct BufferPool
+{
+    struct Block
+    {
+        std::unique_ptr<Byte[]> data;
+        size_t size = 0;
+    };
+
+    Block acquire(size_t sz)
+    {
+        size_t index = classIndex(sz);
+        if (index == c_classes)
+        {
+            incStat<NodeStat::PoolBypass>();
+            return {std::unique_ptr<Byte[]>(new Byte[sz]), sz};
+        }
+        auto& blocks = free_[index];
+        if (blocks.empty())
+        {
+            incStat<NodeStat::PoolMiss>();
+            size_t size = size_t(1) << (index + c_minClassBits);
+            return {std::unique_ptr<Byte[]>(new Byte[size]), size};
+        }
+        incStat<NodeStat::PoolHit>();
+        Block b = std::move(blocks.back());
+        blocks.pop_back();
+        return b;
+    }
+
+    void release(Block b)
+    {
+        size_t index = classIndex(b.size);
+        if (index == c_classes || (size_t(1) << (index + c_minClassBits)) != b.size)
+            return;
+        auto& blocks = free_[index];
+        if (blocks.size() < c_blocksPerClass)
+            blocks.push_back(std::move(b));
+    }
+
+private:
+    static constexpr size_t c_minClassBits = 8; // 256B
+    static constexpr size_t c_maxClassBits = 20; // 1MB, larger frames are not pooled
+    static constexpr size_t c_classes = c_maxClassBits - c_minClassBits + 1;
+    static constexpr size_t c_blocksPerClass = 4;
+
+    static size_t classIndex(size_t sz)
+    {
+        size_t index = 0;
+        while (index < c_classes && (size_t(1) << (index + c_minClassBits)) < sz)
+            ++ index;
+        return index;
+    }
+
+    std::vector<Block> free_[c_classes];
+};
+
+// returns the block to the pool after the message has been handled
+struct PooledBuffer
+{
+    PooledBuffer(BufferPool& pool, size_t sz) : pool_{pool}, block_{pool.acquire(sz)}, size_{sz}
+    {
+    }
+
+    ~PooledBuffer()
+    {
+        pool_.release(std::move(block_));
+    }
+
+    View view()
+    {
+        return {block_.data.get(), size_};
+    }
+
+private:
+    BufferPool& pool_;
+    BufferPool::Block block_;
+    size_t size_;
+};
+
+struct StreamSinks
+{
+    void add(MsgTypeId type, StreamSinkFactory factory)
+    {
+        Lock _{mutex_};
+        factories_[type] = std::move(factory);
+    }
+
+    StreamSinkFactory get(MsgTypeId type)
+    {
+        Lock _{mutex_};
+        auto it = factories_.find(type);
+        return it == factories_.end() ? nullptr : it->second;
+    }
+
+private:
+    using Lock = std::unique_lock<std::mutex>;
+
+    std::mutex mutex_;
+    std::unordered_map<MsgTypeId, StreamSinkFactory> factories_;
+};
+
+// the view must outlive the handler: any msg is invoked in-place
+Handler decodePacket(MsgTypeId type, View v)
+{
+    if (type != c_anyMsgType)
+        return decodeMsg(type, v);
+    AnyMsg& msg = deserialize<AnyMsg>(v);
+    return [&msg] {
+        msg();
+        JLOG("invoked any msg handler");
+    };
+}
+
+}
+
+void registerStreamSink(MsgTypeId type, StreamSinkFactory factory)
+{
+    VERIFY(type != c_anyMsgType && type < c_maxMsgType, "Invalid message type id");
+    single<StreamSinks>().add(type, std::move(factory));
+}
+
+namespace {
+
+// messages sent from the handler inherit the trace id of the received one,
+// the id belongs to the journey thus it survives the suspensions
+struct TraceScope
+{
+    explicit TraceScope(uint64_t traceId) : j_{tlsPtr<Journey>()}
+    {
+        if (j_ == nullptr)
+            return;
+        prev_ = j_->traceId();
+        j_->traceId() = traceId;
+    }
+
+    ~TraceScope()
+    {
+        if (j_ != nullptr)
+            j_->traceId() = prev_;
+    }
+
+private:
+    Journey* j_;
+    uint64_t prev_ = 0;
+};
+
+uint64_t traceIdToSend()
+{
+    Journey* j = tlsPtr<Journey>();
+    uint64_t traceId = j ? j->traceId() : 0;
+    return traceId ? traceId : (uint64_t(thisNode()) << 40) + nextId<struct TraceId>() + 1;
+}
+
+void stampTrace(Buffer& packet, uint64_t traceId)
+{
+    PacketHeader header;
+    VERIFY(packet.size() >= sizeof(header), "Invalid packet size");
+    std::memcpy(&header, packet.data(), sizeof(header));
+    if (header.traceId)
+        return;
+    header.traceId = traceId;
+    std::memcpy(packet.data(), &header, sizeof(header));
+}
+
+// the small packet is sealed once for all the destinations
+void sealPacket(Buffer& packet)
+{
+    PacketHeader header;
+    std::memcpy(&header, packet.data(), sizeof(header));
+    if (header.size > c_fragmentSize)
+        return;
+    sealFrame(header, {{packet.data() + sizeof(header), header.size}});
+    std::memcpy(packet.data(), &header, sizeof(header));
+}
+
+// serialization, compression and checksum run on the codec scheduler
+Buffer encodePacket(const PacketSerializer& serialize, uint64_t traceId)
+{
+    Buffer buf;
+    runOnCodec([&] {
+        buf = serialize();
+        stampTrace(buf, traceId);
+        buf = compressPacket(std::move(buf));
+        sealPacket(buf);
+    });
+    return buf;
+}
+
+// writes the fragments of the single stream one by one
+struct FragmentWriter
+{
+    FragmentWriter(PacketHeader base, uint64_t totalSize)
+        : base_{base}, fragment_{nextId<struct FragmentStreamId>(), totalSize, 0}
+    {
+        VERIFY(totalSize > 0, "Empty stream");
+        base_.flags |= c_flagFragment;
+    }
+
+    bool done() const
+    {
+        return fragment_.offset == fragment_.totalSize;
+    }
+
+    void write(const FrameWriter& write, View chunk)
+    {
+        VERIFY(chunk.size > 0 && chunk.size <= c_fragmentSize, "Invalid chunk size");
+        VERIFY(chunk.size <= fragment_.totalSize - fragment_.offset, "Stream exceeds the total size");
+        PacketHeader header = base_;
+        header.size = uint32_t(sizeof(fragment_) + chunk.size);
+        sealFrame(header, {podToView(fragment_), chunk});
+        write({podToView(header), podToView(fragment_), chunk});
+        fragment_.offset += chunk.size;
+    }
+
+private:
+    PacketHeader base_;
+    FragmentHeader fragment_;
+};
+
+void writeFragments(const FrameWriter& write, PacketHeader base, uint64_t totalSize, const StreamSource& source)
+{
+    FragmentWriter fragments{base, totalSize};
+    while (!fragments.done())
+        fragments.write(write, source());
+}
+
+// splits the packet into the frames, the packet must outlive the object
+struct PacketFrames
+{
+    explicit PacketFrames(View packet)
+    {
+        VERIFY(packet.size >= sizeof(header_), "Invalid packet size");
+        std::memcpy(&header_, packet.data, sizeof(header_));
+        VERIFY(packet.size == sizeof(header_) + header_.size, "Invalid packet size");
+        body_ = {packet.data + sizeof(header_), header_.size};
+        if (header_.size > c_fragmentSize)
+            fragments_.emplace(header_, body_.size);
+    }
+
+    // returns false after the last frame
+    bool writeNext(const FrameWriter& write)
+    {
+        if (!fragments_)
+        {
+            if (header_.crc == 0) // see sealPacket
+                sealFrame(header_, {body_});
+            write({podToView(header_), body_});
+            return false;
+        }
+        View chunk{body_.data, std::min(body_.size, c_fragmentSize)};
+        fragments_->write(write, chunk);
+        body_.data += chunk.size;
+        body_.size -= chunk.size;
+        return !fragments_->done();
+    }
+
+private:
+    PacketHeader header_;
+    View body_;
+    boost::optional<FragmentWriter> fragments_;
+};
+
+}
+
+void writePacket(const FrameWriter& write, View packet)
+{
+    PacketFrames frames{packet};
+    while (frames.writeNext(write))
+    {
+    }
+}
+
+void writeStream(const FrameWriter& write, MsgTypeId type, uint64_t totalSize, const StreamSource& source)
+{
+    PacketHeader header{0, type};
+    header.traceId = traceIdToSend();
+    writeFragments(write, header, totalSize, source);
+}
+
+struct Outbox::Slot
+{
+    Packet packet;
+    bool ready = false;
+};
+
+struct Outbox::Impl
+{
+    using Lock = std::unique_lock<std::mutex>;
+
+    struct Sending
+    {
+        explicit Sending(Packet p) : packet{std::move(p)} {}
+
+        Packet packet;
+        boost::optional<PacketFrames> frames; // created by the writer
+    };
+    using SendingPtr = std::unique_ptr<Sending>;
+
+    explicit Impl(FrameWriter w) : write{std::move(w)}
+    {
+    }
+
+    SlotPtr reserve()
+    {
+        auto slot = std::make_shared<Slot>();
+        Lock _{mutex};
+        slots.push_back(slot);
+        return slot;
+    }
+
+    void fill(const SlotPtr& slot, Packet packet)
+    {
+        {
+            Lock _{mutex};
+            slot->packet = std::move(packet);
+            slot->ready = true;
+            if (writing)
+                return;
+            writing = true;
+        }
+        writeReady();
+    }
+
+private:
+    void writeReady()
+    {
+        while (true)
+        {
+            SendingPtr sending;
+            {
+                Lock _{mutex};
+                startReady0();
+                if (active.empty())
+                {
+                    writing = false;
+                    return;
+                }
+                sending = std::move(active.front());
+                active.pop_front();
+            }
+            if (!writeFrame(*sending))
+                continue;
+            // the next frame goes after the other started packets
+            Lock _{mutex};
+            active.push_back(std::move(sending));
+        }
+    }
+
+    // the packets are started in the order of the reservations
+    void startReady0()
+    {
+        while (!slots.empty() && slots.front()->ready)
+        {
+            Packet packet = std::move(slots.front()->packet);
+            slots.pop_front();
+            if (packet)
+                active.push_back(std::make_unique<Sending>(std::move(packet)));
+        }
+    }
+
+    // returns true if the packet has more frames
+    bool writeFrame(Sending& sending)
+    {
+        try
+        {
+            if (!sending.frames)
+                sending.frames.emplace(bufToView(*sending.packet));
+            return sending.frames->writeNext(write);
+        }
+        catch (std::exception& e)
+        {
+            // the rest of the packet is lost like on the broken connection
+            RJLOG("writing packet failed: " << e.what());
+            return false;
+        }
+    }
+
+    FrameWriter write;
+    std::mutex mutex;
+    std::deque<SlotPtr> slots;
+    std::deque<SendingPtr> active;
+    bool writing = false;
+};
+
+Outbox::Outbox(FrameWriter write) : impl_{new Impl{std::move(write)}}
+{
+}
+
+Outbox::~Outbox()
+{
+}
+
+Outbox::SlotPtr Outbox::reserve()
+{
+    return impl_->reserve();
+}
+
+void Outbox::fill(const SlotPtr& slot, Packet packet)
+{
+    impl_->fill(slot, std::move(packet));
+}
+
+namespace {
+
+struct Outboxes
+{
+    Outbox& get(NodeId dst)
+    {
+        Lock _{mutex_};
+        auto& outbox = outboxes_[dst];
+        if (!outbox)
+        {
+            outbox.reset(new Outbox{[dst](std::initializer_list<View> views) {
+                single<Nodes>().writeFrame(dst, views);
+            }});
+        }
+        return *outbox;
+    }
+
+private:
+    using Lock = std::unique_lock<std::mutex>;
+
+    std::mutex mutex_;
+    std::unordered_map<NodeId, std::unique_ptr<Outbox>> outboxes_;
+};
+
+// the packet is encoded once for all the destinations
+void sendEncoded(const std::vector<NodeId>& dsts, PacketSerializer serialize)
+{
+    std::vector<Outbox*> outboxes;
+    std::vector<Outbox::SlotPtr> slots;
+    for (NodeId n: dsts)
+    {
+        outboxes.push_back(&single<Outboxes>().get(n));
+        slots.push_back(outboxes.back()->reserve());
+    }
+    uint64_t traceId = traceIdToSend(); // taken on the caller journey
+    go([outboxes, slots, serialize, traceId] {
+        Outbox::Packet packet;
+        try
+        {
+            packet = std::make_shared<Buffer>(encodePacket(serialize, traceId));
+        }
+        catch (std::exception& e)
+        {
+            // the reserved slots must be filled to unblock the connections
+            RJLOG("encoding failed: " << e.what());
+        }
+        for (size_t i = 0; i < outboxes.size(); ++ i)
+            outboxes[i]->fill(slots[i], packet);
+    });
+}
+
+}
+
+struct PacketReceiver::Impl
+{
+    struct Stream
+    {
+        MsgTypeId type;
+        uint16_t flags;
+        uint64_t totalSize;
+        uint64_t received = 0;
+        std::unique_ptr<Byte[]> buf; // not zeroed: overwritten by the fragments
+        std::unique_ptr<IStreamSink> sink;
+    };
+
+    Impl(FrameReader r, uint64_t maxReassembled)
+        : read{std::move(r)}, maxReassembled{maxReassembled}
+    {
+    }
+
+    void receive()
+    {
+        PacketHeader header;
+        read(podToView(header));
+        VERIFY(header.version == c_protocolVersion, "Unsupported protocol version");
+        size_t sz = header.size;
+        VERIFY(sz < c_maxFrameSize, "Invalid message size");
+        JLOG("received packet for " << sz << "B, trace: " << header.traceId);
+        PooledBuffer buf{pool, sz};
+        read(buf.view());
+        Handler msg;
+        // the next frame of the connection is read after the execution
+        // thus the order is preserved
+        runOnCodec([&] {
+            // corrupted frame must not be executed
+            VERIFY(checkFrame(header, buf.view()), "Frame checksum mismatch");
+            msg = (header.flags & c_flagFragment) ? receiveFragment(header, buf.view())
+                                                  : decode(header.type, header.flags, buf.view());
+        });
+        if (!msg)
+            return;
+        JLOG("invoking handler, read buffer " << sz << "B");
+        TraceScope trace{header.traceId};
+        msg();
+    }
+
+private:
+    // returns the handler for the last fragment only
+    Handler receiveFragment(const PacketHeader& header, View payload)
+    {
+        FragmentHeader fragment;
+        VERIFY(payload.size > sizeof(fragment), "Invalid fragment size");
+        std::memcpy(&fragment, payload.data, sizeof(fragment));
+        View chunk{payload.data + sizeof(fragment), payload.size - sizeof(fragment)};
+        auto it = streams.find(fragment.streamId);
+        if (it == streams.end())
+        {
+            if (fragment.offset != 0)
+            {
+                // the beginning has been sent to the previous connection
+                JLOG("skipping fragment of unknown stream: " << fragment.streamId);
+                return nullptr;
+            }
+            it = streams.emplace(fragment.streamId, open(header, fragment)).first;
+        }
+        Stream& stream = it->second;
+        VERIFY(fragment.offset == stream.received && fragment.totalSize == stream.totalSize, "Invalid fragment");
+        VERIFY(chunk.size <= stream.totalSize - stream.received, "Fragment exceeds the total size");
+        if (stream.sink)
+            stream.sink->write(chunk);
+        else
+            std::memcpy(stream.buf.get() + stream.received, chunk.data, chunk.size);
+        stream.received += chunk.size;
+        if (stream.received < stream.totalSize)
+            return nullptr;
+
+        Stream done = std::move(stream);
+        streams.erase(it);
+        JLOG("reassembled stream " << fragment.streamId << " for " << done.totalSize << "B");
+        if (done.sink)
+        {
+            std::shared_ptr<IStreamSink> sink = std::move(done.sink);
+            return [sink] {
+                sink->done();
+            };
+        }
+        reassembled -= done.totalSize;
+        std::shared_ptr<Byte> buf{done.buf.release(), std::default_delete<Byte[]>()};
+        Handler msg = decode(done.type, done.flags, {buf.get(), size_t(done.totalSize)});
+        return [buf, msg] {
+            msg();
+        };
+    }
+
+    Handler decode(MsgTypeId type, uint16_t flags, View v)
+    {
+        if ((flags & c_flagCompressed) == 0)
+            return decodePacket(type, v);
+        auto raw = std::make_shared<PooledBuffer>(pool, decompressedSize(v));
+        decompressPayload(v, raw->view());
+        Handler msg = decodePacket(type, raw->view());
+        return [raw, msg] {
+            msg();
+        };
+    }
+
+    Stream open(const PacketHeader& header, const FragmentHeader& fragment)
+    {
+        Stream stream;
+        stream.type = header.type;
+        stream.flags = header.flags & ~c_flagFragment;
+        stream.totalSize = fragment.totalSize;
+        auto factory = single<StreamSinks>().get(header.type);
+        if (factory)
+        {
+            stream.sink = factory(fragment.totalSize);
+        }
+        else
+        {
+            VERIFY(fragment.totalSize <= c_maxMessageSize, "Invalid message size");
+            // the peer must not make the node allocate before sending the data
+            VERIFY(fragment.totalSize <= maxReassembled - reassembled, "Too many bytes are reassembled");
+            stream.buf.reset(new Byte[fragment.totalSize]);
+            reassembled += fragment.totalSize;
+        }
+        return stream;
+    }
+
+    FrameReader read;
+    const uint64_t maxReassembled;
+    uint64_t reassembled = 0;
+    BufferPool pool;
+    std::unordered_map<uint64_t, Stream> streams;
+};
+
+PacketReceiver::PacketReceiver(FrameReader read, uint64_t maxReassembled)
+    : impl_{new Impl{std::move(read), maxReassembled}}
+{
+}
+
+PacketReceiver::~PacketReceiver()
+{
+}
+
+void PacketReceiver::receive()
+{
+    impl_->receive();
+}
+
 MsgListener::~MsgListener()
 {
     cancel();
@@ -151,19 +788,11 @@ void MsgListener::listen()
 {
     listener_.listen(single<NodesConfig>().getInfo(single<NodesConfig>().thisNode()).port,
                      [](Socket& s) {
+        PacketReceiver receiver{[&s](View v) {
+            s.read(v);
+        }};
         while (true)
-        {
-            size_t sz = -1;
-            s.read(podToView(sz));
-            VERIFY(sz < 10 * 1024 * 1024, "Invalid message size");
-            JLOG("received packet for " << sz << "B");
-            Buffer buf(sz);
-            s.read(bufToView(buf));
-            JLOG("invoking handler, read buffer " << sz << "B");
-            //showBuffer(buf);
-            deserialize<AnyMsg>(buf)(); // invoke in-place
-            JLOG("invoked any msg handler");
-        }
+            receiver.receive();
     });
 }
 
@@ -177,6 +806,36 @@ void MsgListener::cleanup()
     cancel();
 }
 
+void runOnCodec(const Handler& handler)
+{
+    Scheduler& codec = scheduler<CodecTag>();
+    if (!codec.attached() || tlsPtr<Journey>() == nullptr)
+    {
+        handler();
+        return;
+    }
+    IScheduler& source = journey().scheduler();
+    std::exception_ptr error;
+    // cancellation and timeout must not unwind the journey on the codec
+    // thread, the pending events are raised after returning to the source
+    bool wasEnabled = disableEvents();
+    teleport(codec);
+    try
+    {
+        handler();
+    }
+    catch (...)
+    {
+        // the exception must not be in flight while switching the threads
+        error = std::current_exception();
+    }
+    teleport(source);
+    if (wasEnabled)
+        enableEventsAndCheck();
+    if (error)
+        std::rethrow_exception(error);
+}
+
 UniqueId genUniqueId()
 {
     return {single<NodesConfig>().thisNode(), nextId<struct MID>()};
@@ -189,24 +848,48 @@ NodeId thisNode()
 
 void send(NodeId dst, AnyMsg msg)
 {
-    auto buf = serializeToPacket(msg);
-    single<Nodes>().send(dst, bufToView(buf));
+    sendSerialized(dst, [msg] {
+        return serializeToPacket(msg);
+    });
+}
+
+void sendPacket(NodeId dst, Buffer buf)
+{
+    sendSerialized(dst, [buf] {
+        return buf;
+    });
+}
+
+void sendSerialized(NodeId dst, PacketSerializer serialize)
+{
+    single<Nodes>().checkConnected(dst);
+    sendEncoded({dst}, std::move(serialize));
 }
 
 // TODO: add broadcast involving local node
 void broadcast(AnyMsg msg)
 {
-    auto buf = serializeToPacket(msg);
-    for (NodeId n: single<NodesConfig>().otherNodes())
-    {
-        JLOG("async broadcasting message to node: " << n);
-        go([n, buf]() mutable {
-            JLOG("broadcasting message to node: " << n);
-            single<Nodes>().send(n, bufToView(buf));
-        });
-    }
+    broadcastSerialized([msg] {
+        return serializeToPacket(msg);
+    });
     //msg();
 }
 
+void sendStream(NodeId dst, MsgTypeId type, uint64_t totalSize, StreamSource source)
+{
+    single<Nodes>().sendStream(dst, type, totalSize, source);
+}
+
+void broadcastPacket(Buffer buf)
+{
+    broadcastSerialized([buf] {
+        return buf;
+    });
+}
+
+void broadcastSerialized(PacketSerializer serialize)
+{
+    sendEncoded(single<NodesConfig>().otherNodes(), std::move(serialize));
 }
 
+}
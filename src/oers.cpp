@@ -18,6 +18,19 @@
 
 namespace synca {
 
+void raise(Status status)
+{
+    switch (status)
+    {
+    case Status::Cancelled:
+        throw CancelledEvent();
+    case Status::Timedout:
+        throw TimedoutEvent();
+    default:
+        break;
+    }
+}
+
 Doer::Doer()
     : Doer{journey().doer()}
 {
@@ -55,6 +68,17 @@ void Goer::timedout()
         state_->timedout();
 }
 
+size_t Goer::onEnded(Handler handler)
+{
+    return state_ ? state_->onEnded(std::move(handler)) : 0;
+}
+
+void Goer::removeEnded(size_t id)
+{
+    if (state_)
+        state_->removeEnded(id);
+}
+
 DetachableDoer::DetachableDoer()
     : DetachableDoer{journey().detachableDoer()}
 {
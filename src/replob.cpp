@@ -24,6 +24,28 @@ namespace synca {
 
 constexpr int c_availabilityTimeoutMs = 1000/5;
 
+REGISTER_MSG(VoteMsg)
+REGISTER_MSG(CommitMsg)
+
+bool linkReplobMsgs()
+{
+    return true;
+}
+
+void VoteMsg::operator()()
+{
+    Voting* p = phantomPtr<Voting>(stepId);
+    if (p)
+        p->vote(carries, srcNode, nodes);
+}
+
+void CommitMsg::operator()()
+{
+    Voting* p = phantomPtr<Voting>(stepId);
+    if (p)
+        p->commit(carries);
+}
+
 std::ostream& operator<<(std::ostream& o, CarryMsg msg)
 {
     return o << "[" << msg.stepId << "]{" << msg.msgId.first << ":" << msg.msgId.second << "}";
@@ -0,0 +1,473 @@
+/*
+ * Copyright 2015 Grigory Demchenko (aka gridem)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include <synca/semaphore.h>
+
+#include "synca_impl.h"
+
+namespace synca {
+
+struct SemaphoreStat
+{
+    struct Wait {};
+    struct WaitUs {};
+    struct WaitCancelled {};
+};
+
+struct RateLimiterStat
+{
+    struct Wait {};
+    struct WaitUs {};
+};
+
+struct LatchStat
+{
+    struct Wait {};
+    struct WaitUs {};
+};
+
+struct BarrierStat
+{
+    struct Wait {};
+    struct WaitUs {};
+};
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Doers = std::vector<DetachableDoer>;
+
+// outside of the guard: the journeys are resumed
+void releaseDoers(Doers& doers)
+{
+    for (auto&& d: doers)
+        d.releaseAndDone();
+}
+
+void releaseAll(WaitList& waiters, Doers& doers)
+{
+    while (auto d = waiters.popAcquired())
+        doers.push_back(std::move(*d));
+}
+
+}
+
+struct Semaphore::Impl
+{
+    using Lock = std::unique_lock<std::mutex>;
+
+    Impl(size_t permits, Fairness fairness)
+        : permits_{permits}, fairness_{fairness}
+    {
+    }
+
+    void acquire(size_t n)
+    {
+        WaitNode node{DetachableDoer{}};
+        node.count = n;
+        {
+            Lock _{mutex_};
+            if (tryAcquire0(n))
+                return;
+            incStat<SemaphoreStat::Wait>();
+            waiters_.push(node);
+        }
+        ScopedTime<SemaphoreStat::WaitUs> t;
+        try
+        {
+            waitForDone();
+        }
+        catch (...)
+        {
+            Doers doers;
+            {
+                Lock _{mutex_};
+                if (node.linked)
+                {
+                    incStat<SemaphoreStat::WaitCancelled>();
+                    waiters_.remove(node);
+                    // the head may have blocked the next waiters
+                    wake0(doers);
+                }
+            }
+            releaseDoers(doers);
+            throw;
+        }
+    }
+
+    bool tryAcquire(size_t n)
+    {
+        Lock _{mutex_};
+        return tryAcquire0(n);
+    }
+
+    void release(size_t n)
+    {
+        Doers doers;
+        {
+            Lock _{mutex_};
+            permits_ += n;
+            wake0(doers);
+        }
+        releaseDoers(doers);
+    }
+
+    size_t available() const
+    {
+        Lock _{mutex_};
+        return permits_;
+    }
+
+private:
+    bool tryAcquire0(size_t n)
+    {
+        if (permits_ < n || (fairness_ == Fairness::Fifo && !waiters_.empty()))
+            return false;
+        permits_ -= n;
+        return true;
+    }
+
+    void wake0(Doers& doers)
+    {
+        WaitNode* node = waiters_.first();
+        while (node != nullptr)
+        {
+            WaitNode* next = node->next;
+            if (node->count <= permits_)
+            {
+                waiters_.remove(*node);
+                if (node->doer.acquire())
+                {
+                    permits_ -= node->count;
+                    doers.push_back(std::move(node->doer));
+                }
+            }
+            else if (fairness_ == Fairness::Fifo)
+            {
+                return;
+            }
+            node = next;
+        }
+    }
+
+    mutable std::mutex mutex_;
+    size_t permits_;
+    const Fairness fairness_;
+    WaitList waiters_;
+};
+
+Semaphore::Semaphore(size_t permits, Fairness fairness)
+    : impl_{std::make_unique<Impl>(permits, fairness)}
+{
+}
+
+Semaphore::~Semaphore()
+{
+}
+
+void Semaphore::acquire(size_t n)
+{
+    impl_->acquire(n);
+}
+
+bool Semaphore::tryAcquire(size_t n)
+{
+    return impl_->tryAcquire(n);
+}
+
+void Semaphore::release(size_t n)
+{
+    impl_->release(n);
+}
+
+size_t Semaphore::available() const
+{
+    return impl_->available();
+}
+
+/*
+ * Fifo: every acquire reserves its tokens at once, the balance may become
+ * negative, and the journey sleeps until its reservation is covered.
+ * Barging: the journey sleeps for the current deficit and retries.
+ */
+struct RateLimiter::Impl
+{
+    using Lock = std::unique_lock<std::mutex>;
+
+    Impl(double rate, size_t burst, Fairness fairness)
+        : rate_{rate}, burst_{double(burst)}, tokens_{double(burst)}, fairness_{fairness}
+    {
+        VERIFY(rate > 0, "Rate must be positive");
+    }
+
+    void acquire(size_t n)
+    {
+        // the bucket never holds more than burst: the retry would wait forever
+        if (fairness_ == Fairness::Fifo || n > burst_)
+            reserve(n);
+        else
+            retry(n);
+    }
+
+    bool tryAcquire(size_t n)
+    {
+        Lock _{mutex_};
+        refill0();
+        if (tokens_ < n)
+            return false;
+        tokens_ -= n;
+        return true;
+    }
+
+private:
+    void reserve(size_t n)
+    {
+        double deficit;
+        {
+            Lock _{mutex_};
+            refill0();
+            tokens_ -= n;
+            deficit = -tokens_;
+        }
+        if (deficit <= 0)
+            return;
+        try
+        {
+            sleep0(deficit);
+        }
+        catch (...)
+        {
+            Lock _{mutex_};
+            tokens_ += n;
+            throw;
+        }
+    }
+
+    void retry(size_t n)
+    {
+        while (true)
+        {
+            double deficit;
+            {
+                Lock _{mutex_};
+                refill0();
+                if (tokens_ >= n)
+                {
+                    tokens_ -= n;
+                    return;
+                }
+                deficit = n - tokens_;
+            }
+            sleep0(deficit);
+        }
+    }
+
+    void sleep0(double deficit)
+    {
+        incStat<RateLimiterStat::Wait>();
+        ScopedTime<RateLimiterStat::WaitUs> t;
+        sleepa(std::max(1, int(std::ceil(deficit * 1000 / rate_))));
+    }
+
+    void refill0()
+    {
+        auto now = Clock::now();
+        double elapsed = std::chrono::duration<double>(now - last_).count();
+        last_ = now;
+        tokens_ = std::min(burst_, tokens_ + elapsed * rate_);
+    }
+
+    std::mutex mutex_;
+    const double rate_;
+    const double burst_;
+    double tokens_;
+    Clock::time_point last_ = Clock::now();
+    const Fairness fairness_;
+};
+
+RateLimiter::RateLimiter(double rate, size_t burst, Fairness fairness)
+    : impl_{std::make_unique<Impl>(rate, burst, fairness)}
+{
+}
+
+RateLimiter::~RateLimiter()
+{
+}
+
+void RateLimiter::acquire(size_t n)
+{
+    impl_->acquire(n);
+}
+
+bool RateLimiter::tryAcquire(size_t n)
+{
+    return impl_->tryAcquire(n);
+}
+
+struct Latch::Impl
+{
+    using Lock = std::unique_lock<std::mutex>;
+
+    explicit Impl(size_t count)
+        : count_{count}
+    {
+    }
+
+    void countDown(size_t n)
+    {
+        Doers doers;
+        {
+            Lock _{mutex_};
+            if (count_ == 0)
+                return;
+            count_ -= std::min(n, count_);
+            if (count_ == 0)
+                releaseAll(waiters_, doers);
+        }
+        releaseDoers(doers);
+    }
+
+    void wait()
+    {
+        WaitNode node{DetachableDoer{}};
+        {
+            Lock _{mutex_};
+            if (count_ == 0)
+                return;
+            incStat<LatchStat::Wait>();
+            waiters_.push(node);
+        }
+        ScopedTime<LatchStat::WaitUs> t;
+        try
+        {
+            waitForDone();
+        }
+        catch (...)
+        {
+            Lock _{mutex_};
+            if (node.linked)
+                waiters_.remove(node);
+            throw;
+        }
+    }
+
+    bool tryWait() const
+    {
+        Lock _{mutex_};
+        return count_ == 0;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    size_t count_;
+    WaitList waiters_;
+};
+
+Latch::Latch(size_t count)
+    : impl_{std::make_unique<Impl>(count)}
+{
+}
+
+Latch::~Latch()
+{
+}
+
+void Latch::countDown(size_t n)
+{
+    impl_->countDown(n);
+}
+
+void Latch::wait()
+{
+    impl_->wait();
+}
+
+bool Latch::tryWait() const
+{
+    return impl_->tryWait();
+}
+
+struct Barrier::Impl
+{
+    using Lock = std::unique_lock<std::mutex>;
+
+    explicit Impl(size_t parties)
+        : parties_{parties}
+    {
+        VERIFY(parties > 0, "Barrier must have parties");
+    }
+
+    void arriveAndWait()
+    {
+        WaitNode node{DetachableDoer{}};
+        {
+            Doers doers;
+            Lock _{mutex_};
+            if (++ arrived_ == parties_)
+            {
+                arrived_ = 0;
+                releaseAll(waiters_, doers);
+                _.unlock();
+                releaseDoers(doers);
+                return;
+            }
+            incStat<BarrierStat::Wait>();
+            waiters_.push(node);
+        }
+        ScopedTime<BarrierStat::WaitUs> t;
+        try
+        {
+            waitForDone();
+        }
+        catch (...)
+        {
+            Lock _{mutex_};
+            // cancelled before the barrier was tripped: not arrived
+            if (node.linked)
+            {
+                waiters_.remove(node);
+                -- arrived_;
+            }
+            throw;
+        }
+    }
+
+private:
+    std::mutex mutex_;
+    const size_t parties_;
+    size_t arrived_ = 0;
+    WaitList waiters_;
+};
+
+Barrier::Barrier(size_t parties)
+    : impl_{std::make_unique<Impl>(parties)}
+{
+}
+
+Barrier::~Barrier()
+{
+}
+
+void Barrier::arriveAndWait()
+{
+    impl_->arriveAndWait();
+}
+
+}
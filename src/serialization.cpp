@@ -16,6 +16,12 @@
 
 #include "synca_impl.h"
 
+#if defined(flagGCC_LIKE) && defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(flagMSC)
+#include <intrin.h>
+#endif
+
 namespace synca {
 
 /*
@@ -28,7 +34,7 @@ struct IAllocator : IObject
 
 struct MemoryAllocator;
 
-TLS Buffer* t_buffer = nullptr;
+TLS View* t_arena = nullptr;
 //TLS IAllocator* t_allocator = nullptr;
 TLS MemoryAllocator* t_allocator = nullptr;
 
@@ -62,45 +68,69 @@ IAllocator* getAllocator()
 
 
 
-Buffer& tlsBuffer()
+View& tlsArena()
 {
-    auto buf = t_buffer;
-    if (buf == nullptr)
+    auto arena = t_arena;
+    if (arena == nullptr)
     {
-        buf = new Buffer(1024*1024*10); // 10MB
-        t_buffer = buf;
+        // memory is not touched until used: no page faults for the unused tail
+        arena = new View{Ptr(DefaultAllocator::alloc(c_arenaInitialSize)), c_arenaInitialSize};
+        t_arena = arena;
     }
-    return *buf;
+    return *arena;
+}
+
+void growArena()
+{
+    View& arena = tlsArena();
+    VERIFY(arena.size < c_arenaMaxSize, "MemoryAllocator: allocation failed: oversize");
+    size_t size = arena.size * 2;
+    DefaultAllocator::dealloc(arena.data);
+    arena.data = Ptr(DefaultAllocator::alloc(size));
+    arena.size = size;
 }
 
-MemoryAllocator::MemoryAllocator() : buffer_{tlsBuffer()}
+View arenaReserve(size_t size)
 {
-    t_allocator = this;
+    while (tlsArena().size < size)
+        growArena();
+    return {tlsArena().data, size};
 }
 
-MemoryAllocator::~MemoryAllocator()
+const char* ArenaOverflow::what() const noexcept
+{
+    return "Arena overflow";
+}
+
+MemoryAllocator::MemoryAllocator() : arena_{tlsArena()}
 {
-    t_allocator = nullptr;
 }
 
 void *MemoryAllocator::alloc(size_t sz)// override
 {
-    Ptr p = buffer_.data() + offset_;
+    Ptr p = arena_.data + offset_;
     size_t diff = sz % c_ptrSize;
     if (diff)
         sz += c_ptrSize - diff;
-    VERIFY(offset_ + sz <= buffer_.size(), "MemoryAllocator: allocation failed: oversize");
+    if (offset_ + sz > arena_.size)
+        throw ArenaOverflow();
     offset_ += sz;
+    // zeroing is required: padding must be equal in both copies to diff them
     std::memset(p, 0, sz);
     return p;
 }
 
 void MemoryAllocator::dealloc(void *p)// override
 {
-    if (p < buffer_.data() || p >= buffer_.data() + buffer_.size())
+    if (p < arena_.data || p >= arena_.data + arena_.size)
         DefaultAllocator::dealloc(p);
 }
 
+Ptr MemoryAllocator::data() const
+{
+    return arena_.data;
+}
+
 size_t MemoryAllocator::size() const
 {
     return offset_;
@@ -111,6 +141,160 @@ void MemoryAllocator::setSize(size_t size)
     offset_ = size;
 }
 
+ArenaScope::ArenaScope(MemoryAllocator& a) : prev_{t_allocator}
+{
+    t_allocator = &a;
+}
+
+ArenaScope::~ArenaScope()
+{
+    t_allocator = prev_;
+}
+
+namespace {
+
+using RelocateFn = void (*)(PtrArray data, const Byte* bitmap, size_t pCount, intptr_t base);
+
+int lowestBit(BitmapWord word)
+{
+#ifdef flagGCC_LIKE
+    return __builtin_ctzll(word);
+#else
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return index;
+#endif
+}
+
+BitmapWord loadWord(const Byte* bitmap, size_t i)
+{
+    BitmapWord word;
+    std::memcpy(&word, bitmap + i * sizeof(BitmapWord), sizeof(word));
+    return word;
+}
+
+void relocateWord(PtrArray data, BitmapWord word, intptr_t base)
+{
+    while (word)
+    {
+        data[lowestBit(word)] += base;
+        word &= word - 1;
+    }
+}
+
+void relocateScalar(PtrArray data, const Byte* bitmap, size_t pCount, intptr_t base)
+{
+    size_t words = (pCount + c_bitmapBits - 1) / c_bitmapBits;
+    for (size_t i = 0; i < words; ++ i)
+        relocateWord(data + i * c_bitmapBits, loadWord(bitmap, i), base);
+}
+
+#if defined(flagGCC_LIKE) && defined(__x86_64__)
+// dense pointer slots (maps, string vectors): 4 slots per instruction
+__attribute__((target("avx2")))
+void relocateAvx2(PtrArray data, const Byte* bitmap, size_t pCount, intptr_t base)
+{
+    const __m256i bits = _mm256_set_epi64x(8, 4, 2, 1);
+    const __m256i vbase = _mm256_set1_epi64x(base);
+    size_t words = pCount / c_bitmapBits;
+    // the partial tail word may cover slots beyond the image
+    if (pCount % c_bitmapBits)
+        relocateWord(data + words * c_bitmapBits, loadWord(bitmap, words), base);
+    for (size_t i = 0; i < words; ++ i)
+    {
+        BitmapWord word = loadWord(bitmap, i);
+        auto slots = (__m256i*)(data + i * c_bitmapBits);
+        for (; word; word >>= 4, ++ slots)
+        {
+            if ((word & 0xf) == 0)
+                continue;
+            __m256i mask = _mm256_cmpeq_epi64(
+                _mm256_and_si256(_mm256_set1_epi64x(word & 0xf), bits), bits);
+            __m256i v = _mm256_loadu_si256(slots);
+            _mm256_storeu_si256(slots, _mm256_add_epi64(v, _mm256_and_si256(mask, vbase)));
+        }
+    }
+}
+
+RelocateFn selectRelocate()
+{
+    return __builtin_cpu_supports("avx2") ? relocateAvx2 : relocateScalar;
+}
+#else
+RelocateFn selectRelocate()
+{
+    return relocateScalar;
+}
+#endif
+
+const RelocateFn c_relocate = selectRelocate();
+
+}
+
+Ptr relocate(View v)
+{
+    ImageTrailer trailer;
+    VERIFY(v.size >= sizeof(trailer), "Invalid buffer size: must contain trailer");
+    std::memcpy(&trailer, v.data + v.size - sizeof(trailer), sizeof(trailer));
+    size_t bitmapSize = size_t(trailer.bitmapWords) * sizeof(BitmapWord);
+    VERIFY(size_t(trailer.imageSize) + bitmapSize + sizeof(trailer) == v.size, "Invalid buffer size");
+    if (trailer.bitmapWords == 0)
+        return v.data;
+
+    size_t pCount = trailer.imageSize / c_ptrSize;
+    VERIFY(trailer.imageSize % c_ptrSize == 0, "Invalid image size: must be aligned");
+    VERIFY((pCount + c_bitmapBits - 1) / c_bitmapBits == trailer.bitmapWords, "Invalid bitmap size");
+    const Byte* bitmap = v.data + trailer.imageSize;
+    if (pCount % c_bitmapBits)
+    {
+        BitmapWord last = loadWord(bitmap, trailer.bitmapWords - 1);
+        VERIFY((last >> (pCount % c_bitmapBits)) == 0, "Invalid data index");
+    }
+    c_relocate(PtrArray(v.data), bitmap, pCount, intptr_t(v.data));
+    return v.data;
+}
+
+namespace {
+
+struct MsgTypeInfo
+{
+    MsgDecode decode = nullptr;
+    const char* name = nullptr;
+};
+
+// function local: registration happens on static init of other units
+std::vector<MsgTypeInfo>& msgTypes()
+{
+    static std::vector<MsgTypeInfo> types(c_maxMsgType);
+    return types;
+}
+
+}
+
+bool registerMsgType(MsgTypeId type, MsgDecode decode, const char* name)
+{
+    VERIFY(type != c_anyMsgType && type < c_maxMsgType, "Invalid message type id");
+    auto& info = msgTypes()[type];
+    VERIFY(info.decode == nullptr, "Duplicate message type id");
+    info.decode = decode;
+    info.name = name;
+    return true;
+}
+
+Handler decodeMsg(MsgTypeId type, View v)
+{
+    VERIFY(type < c_maxMsgType, "Invalid message type id");
+    auto& info = msgTypes()[type];
+    VERIFY(info.decode != nullptr, "Unknown message type id");
+    JLOG("decoding message: " << info.name);
+    return info.decode(v);
+}
+
+void dispatchMsg(MsgTypeId type, View v)
+{
+    decodeMsg(type, v)();
+}
+
 void bufInsertView(Buffer &b, View v)
 {
     b.insert(b.end(), v.data, v.data + v.size);
@@ -121,6 +305,38 @@ View bufToView(Buffer &b)
     return {b.data(), b.size()};
 }
 
+Writer::Writer(Buffer& buf) : buf_{buf}
+{
+}
+
+void Writer::write(const void* p, size_t size)
+{
+    auto b = static_cast<const Byte*>(p);
+    buf_.insert(buf_.end(), b, b + size);
+}
+
+Reader::Reader(View v) : v_{v}
+{
+}
+
+void Reader::read(void* p, size_t size)
+{
+    VERIFY(size <= v_.size, "Serial: unexpected end of data");
+    std::memcpy(p, v_.data, size);
+    v_.data += size;
+    v_.size -= size;
+}
+
+bool Reader::empty() const
+{
+    return v_.size == 0;
+}
+
+size_t Reader::left() const
+{
+    return v_.size;
+}
+
 void showBuffer(Buffer& buf)
 {
     int sz = buf.size() / c_ptrSize;
@@ -132,6 +348,7 @@ void showBuffer(Buffer& buf)
 
 }
 
+#ifdef flagARENA_NEW
 void* operator new(size_t sz)
 {
     return synca::t_allocator ? synca::t_allocator->alloc(sz) : synca::DefaultAllocator::alloc(sz);
@@ -141,4 +358,4 @@ void operator delete(void *p) noexcept
 {
     synca::t_allocator ? synca::t_allocator->dealloc(p) : synca::DefaultAllocator::dealloc(p);
 }
-
+#endif
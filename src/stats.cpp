@@ -18,6 +18,7 @@
 
 #ifdef flagGCC_LIKE
 #include <cxxabi.h>
+#include <time.h>
 
 struct Free
 {
@@ -48,6 +49,18 @@ std::string demangle(const char* name)
 
 namespace synca {
 
+ThreadCpuClock::time_point ThreadCpuClock::now()
+{
+#ifdef flagGCC_LIKE
+    timespec ts;
+    VERIFY(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0, "Thread cpu time is unavailable");
+    return time_point{duration{rep(ts.tv_sec) * 1000000000 + ts.tv_nsec}};
+#else
+    // falls back to the wall time
+    return time_point{std::chrono::duration_cast<duration>(std::chrono::steady_clock::now().time_since_epoch())};
+#endif
+}
+
 struct StatRegistrar
 {
     void registerValue(const char* name, StatCounter* v);
@@ -59,14 +72,8 @@ private:
     std::map<std::string, StatCounter*> infos_;
 };
 
-void post(Handler h)
-{
-    ((IScheduler&)scheduler<DefaultTag>()).schedule(std::move(h));
-}
-
 void detail::registerStat(const char *name, StatCounter *v)
 {
-    // TODO: think about post function for default scheduler
     post([name, v] {
         try
         {
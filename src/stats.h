@@ -59,6 +59,31 @@ uint64_t decStat()
     return addStat<T>(-1);
 }
 
+// steady clock of the cpu time consumed by the calling thread
+struct ThreadCpuClock
+{
+    using duration = std::chrono::nanoseconds;
+    using rep = duration::rep;
+    using period = duration::period;
+    using time_point = std::chrono::time_point<ThreadCpuClock>;
+    static constexpr bool is_steady = true;
+
+    static time_point now();
+};
+
+// accumulates the time spent in the scope in microseconds
+template<typename T_stat, typename T_clock = std::chrono::steady_clock>
+struct ScopedTime
+{
+    ~ScopedTime()
+    {
+        addStat<T_stat>(std::chrono::duration_cast<std::chrono::microseconds>(T_clock::now() - start_).count());
+    }
+
+private:
+    typename T_clock::time_point start_ = T_clock::now();
+};
+
 template<typename T>
 struct InstanceStat
 {
@@ -25,6 +25,7 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <chrono>
 
 #include <synca/synca.h>
 #include <synca/log.h>
@@ -32,6 +33,7 @@
 #include "stats.h"
 #include "coro.h"
 #include "journey.h"
+#include "wait_list.h"
 
 namespace synca {
 
@@ -41,5 +43,8 @@ struct AsioService : boost::asio::io_service
 
 typedef boost::system::error_code ErrorCode;
 
+// pause instruction for spin loops
+void cpuRelax();
+
 }
 
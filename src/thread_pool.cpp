@@ -14,8 +14,15 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <chrono>
+
 #include "synca_impl.h"
 
+#ifdef flagMSC
+#include <intrin.h>
+#endif
+
 // ThreadPool log: inside ThreadPool functionality
 #define PLOG(D_msg)             TLOG("@" << this->name() << ": " << D_msg)
 
@@ -23,6 +30,7 @@ namespace synca {
 
 TLS int t_number = 0;
 TLS const char* t_name = "main";
+TLS bool t_retired = false;
 
 const char* name()
 {
@@ -34,6 +42,15 @@ int number()
     return t_number;
 }
 
+void cpuRelax()
+{
+#if defined(flagMSC) && (defined(_M_IX86) || defined(_M_X64))
+    _mm_pause();
+#elif defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#endif
+}
+
 std::thread createThread(Handler handler, int number, const char* name)
 {
     return std::thread([handler, number, name] {
@@ -53,17 +70,74 @@ std::thread createThread(Handler handler, int number, const char* name)
     });
 }
 
+struct ThreadPoolStat
+{
+    struct ExtraThreads {};
+    struct Grow {};
+    struct Shrink {};
+    struct DelayOverThreshold {};
+    struct Stalled {};
+};
+
+// log2 histogram of queue delays in microseconds
+struct DelayHistogram
+{
+    void add(uint64_t us)
+    {
+        size_t i = 0;
+        while (us > 1 && i < c_buckets - 1)
+        {
+            us >>= 1;
+            ++ i;
+        }
+        buckets_[i].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint64_t percentile(int p) const
+    {
+        uint64_t total = 0;
+        for (auto&& b: buckets_)
+            total += b.load(std::memory_order_relaxed);
+        if (total == 0)
+            return 0;
+        uint64_t rank = (total * p + 99) / 100;
+        uint64_t sum = 0;
+        for (size_t i = 0; i < c_buckets; ++ i)
+        {
+            sum += buckets_[i].load(std::memory_order_relaxed);
+            if (sum >= rank)
+                return uint64_t(1) << i;
+        }
+        return uint64_t(1) << (c_buckets - 1);
+    }
+
+private:
+    static constexpr size_t c_buckets = 32;
+
+    Atomic<uint64_t> buckets_[c_buckets];
+};
+
 struct ThreadPool::Impl
 {
     using Work = boost::asio::io_service::work;
+    using Clock = std::chrono::steady_clock;
 
-    Impl(size_t threadCount, const char* name) : tpName(name)
+    Impl(const ThreadPoolConfig& cfg, const char* name)
+        : tpName(name), config(cfg), idleTimer(service)
     {
+        VERIFY(config.minThreads > 0, "Thread pool must have threads");
+        VERIFY(config.minThreads <= config.maxThreads, "Invalid thread pool bounds");
         resetWork();
-        threads.reserve(threadCount);
-        for (size_t i = 0; i < threadCount; ++ i)
-            threads.emplace_back(createThread([this] { loop(); }, i, name));
-        PLOG("thread pool created with threads: " << threadCount);
+        threads.reserve(config.maxThreads);
+        std::unique_lock<std::mutex> lock(mutex);
+        for (size_t i = 0; i < config.minThreads; ++ i)
+            addThread();
+        armIdleTimer();
+        if (isElastic())
+            monitorThread = createThread([this] { monitor(); }, -1, tpName);
+        PLOG("thread pool created with threads: " << config.minThreads
+             << (isElastic() ? ", elastic up to: " : "")
+             << (isElastic() ? std::to_string(config.maxThreads) : ""));
     }
 
     ~Impl()
@@ -71,8 +145,12 @@ struct ThreadPool::Impl
         mutex.lock();
         toStop = true;
         work.reset();
+        idleTimer.cancel();
         mutex.unlock();
+        monitorCond.notify_all();
         PLOG("stopping thread pool");
+        if (monitorThread.joinable())
+            monitorThread.join();
         for (size_t i = 0; i < threads.size(); ++ i)
             threads[i].join();
         PLOG("thread pool stopped");
@@ -88,28 +166,107 @@ struct ThreadPool::Impl
         return tpName;
     }
 
+    bool isElastic() const
+    {
+        return config.maxThreads > config.minThreads;
+    }
+
+    void schedule(Handler handler)
+    {
+        if (!isElastic())
+        {
+            service.post(std::move(handler));
+            return;
+        }
+        auto scheduled = Clock::now();
+        posted.fetch_add(1, std::memory_order_relaxed);
+        service.post([this, scheduled, handler = std::move(handler)] {
+            onStart(scheduled);
+            // the thrown handler must not leave the thread busy forever
+            MCleanup {
+                busy.fetch_sub(1, std::memory_order_relaxed);
+            };
+            handler();
+        });
+    }
+
     void loop()
     {
         while (true)
         {
-            service.run();
+            run();
             std::unique_lock<std::mutex> lock(mutex);
             if (toStop)
                 break;
+            if (t_retired)
+            {
+                retired.push_back(std::this_thread::get_id());
+                PLOG("thread retired");
+                break;
+            }
             if (!work)
             {
                 resetWork();
                 service.reset();
+                armIdleTimer();
                 lock.unlock();
                 cond.notify_all();
             }
         }
     }
 
+    void run()
+    {
+        if (config.spinUs > 0)
+        {
+            spin();
+            return;
+        }
+        if (!isElastic())
+        {
+            service.run();
+            return;
+        }
+        // a retired thread leaves the loop after the retire handler
+        while (!t_retired && service.run_one())
+        {
+        }
+    }
+
+    // polls run queue and socket readiness for spinUs after the last handler
+    // before parking in the blocking run_one
+    // counters are per pool: the thread may park before any scheduler is attached
+    void spin()
+    {
+        auto window = std::chrono::microseconds(config.spinUs);
+        auto last = Clock::now();
+        while (!t_retired)
+        {
+            if (service.poll_one())
+            {
+                spinHits.fetch_add(1, std::memory_order_relaxed);
+                last = Clock::now();
+                continue;
+            }
+            if (service.stopped())
+                return;
+            if (Clock::now() - last < window)
+            {
+                cpuRelax();
+                continue;
+            }
+            parks.fetch_add(1, std::memory_order_relaxed);
+            if (!service.run_one())
+                return;
+            last = Clock::now();
+        }
+    }
+
     void wait()
     {
         std::unique_lock<std::mutex> lock(mutex);
         work.reset();
+        idleTimer.cancel();
         while (true)
         {
             cond.wait(lock);
@@ -119,17 +276,175 @@ struct ThreadPool::Impl
         }
     }
 
+    ThreadPoolStats stats() const
+    {
+        return {threadCount.load(std::memory_order_relaxed),
+                delays.percentile(50), delays.percentile(90), delays.percentile(99),
+                spinHits.load(std::memory_order_relaxed), parks.load(std::memory_order_relaxed)};
+    }
+
+    void onStart(Clock::time_point scheduled)
+    {
+        auto now = Clock::now();
+        auto delayUs = std::chrono::duration_cast<std::chrono::microseconds>(now - scheduled).count();
+        delays.add(delayUs);
+        started.fetch_add(1, std::memory_order_relaxed);
+        size_t current = busy.fetch_add(1, std::memory_order_relaxed) + 1;
+        size_t peak = peakBusy.load(std::memory_order_relaxed);
+        while (peak < current && !peakBusy.compare_exchange_weak(peak, current, std::memory_order_relaxed))
+        {
+        }
+        if (delayUs <= config.growDelayUs)
+            return;
+        incStat<ThreadPoolStat::DelayOverThreshold>();
+        // handlers queued before the last growth don't justify a new thread
+        if (scheduled.time_since_epoch().count() > lastGrow.load(std::memory_order_relaxed))
+            grow(now);
+    }
+
+    // onStart doesn't see the delay while all the threads are blocked:
+    // the queue that has not moved during the whole period is stalled
+    void monitor()
+    {
+        auto period = std::chrono::microseconds(std::max(config.growDelayUs, 100));
+        std::unique_lock<std::mutex> lock(mutex);
+        uint64_t lastStarted = 0;
+        bool waiting = false;
+        while (!toStop)
+        {
+            monitorCond.wait_for(lock, period);
+            if (toStop)
+                break;
+            uint64_t current = started.load(std::memory_order_relaxed);
+            bool queued = posted.load(std::memory_order_relaxed) != current;
+            if (waiting && queued && current == lastStarted)
+            {
+                PLOG("thread pool stalled");
+                lock.unlock();
+                incStat<ThreadPoolStat::Stalled>();
+                grow(Clock::now());
+                lock.lock();
+            }
+            waiting = queued;
+            lastStarted = current;
+        }
+    }
+
+    void grow(Clock::time_point now)
+    {
+        if (threadCount.load(std::memory_order_relaxed) >= config.maxThreads)
+            return;
+        std::unique_lock<std::mutex> lock(mutex);
+        if (toStop || threadCount.load(std::memory_order_relaxed) >= config.maxThreads)
+            return;
+        lastGrow.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+        joinRetired();
+        addThread();
+        incStat<ThreadPoolStat::ExtraThreads>();
+        incStat<ThreadPoolStat::Grow>();
+        PLOG("thread pool grown to: " << threadCount.load(std::memory_order_relaxed));
+        armIdleTimer();
+    }
+
+    // under mutex
+    void addThread()
+    {
+        threads.emplace_back(createThread([this] { loop(); }, nextNumber ++, tpName));
+        threadCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // under mutex
+    void joinRetired()
+    {
+        for (auto&& id: retired)
+        {
+            auto it = std::find_if(threads.begin(), threads.end(), [id](const std::thread& t) {
+                return t.get_id() == id;
+            });
+            if (it == threads.end())
+                continue;
+            it->join();
+            threads.erase(it);
+        }
+        retired.clear();
+    }
+
+    // under mutex
+    void armIdleTimer()
+    {
+        if (!isElastic() || toStop || !work || idleTimerArmed)
+            return;
+        if (threadCount.load(std::memory_order_relaxed) <= config.minThreads)
+            return;
+        idleTimerArmed = true;
+        idleTimer.expires_from_now(boost::posix_time::milliseconds(config.idleTimeoutMs));
+        idleTimer.async_wait([this](const ErrorCode& error) {
+            onIdleTimeout(error);
+        });
+    }
+
+    void onIdleTimeout(const ErrorCode& error)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        idleTimerArmed = false;
+        if (error || toStop)
+            return;
+        // retire the threads that were not needed during the whole timeout
+        size_t needed = std::max(peakBusy.exchange(busy.load(std::memory_order_relaxed),
+                                                   std::memory_order_relaxed), config.minThreads);
+        while (threadCount.load(std::memory_order_relaxed) > needed)
+        {
+            threadCount.fetch_sub(1, std::memory_order_relaxed);
+            decStat<ThreadPoolStat::ExtraThreads>();
+            incStat<ThreadPoolStat::Shrink>();
+            service.post([] {
+                t_retired = true;
+            });
+        }
+        PLOG("thread pool shrunk to: " << threadCount.load(std::memory_order_relaxed));
+        armIdleTimer();
+    }
+
     const char* tpName;
+    ThreadPoolConfig config;
     std::unique_ptr<Work> work;
     AsioService service;
+    boost::asio::deadline_timer idleTimer;
     std::vector<std::thread> threads;
+    std::vector<std::thread::id> retired;
     std::mutex mutex;
     std::condition_variable cond;
+    std::thread monitorThread;
+    std::condition_variable monitorCond;
     bool toStop = false;
+    bool idleTimerArmed = false;
+    int nextNumber = 0;
+    Atomic<size_t> threadCount;
+    Atomic<size_t> busy;
+    Atomic<size_t> peakBusy;
+    Atomic<Clock::rep> lastGrow;
+    Atomic<uint64_t> posted;
+    Atomic<uint64_t> started;
+    Atomic<uint64_t> spinHits;
+    Atomic<uint64_t> parks;
+    DelayHistogram delays;
 };
 
+ThreadPoolConfig fixedConfig(size_t threadCount)
+{
+    ThreadPoolConfig config;
+    config.minThreads = threadCount;
+    config.maxThreads = threadCount;
+    return config;
+}
+
 ThreadPool::ThreadPool(size_t threadCount, const char* name)
-    : impl(new Impl(threadCount, name))
+    : impl(new Impl(fixedConfig(threadCount), name))
+{
+}
+
+ThreadPool::ThreadPool(const ThreadPoolConfig& config, const char* name)
+    : impl(new Impl(config, name))
 {
 }
 
@@ -139,7 +454,7 @@ ThreadPool::~ThreadPool()
 
 void ThreadPool::schedule(Handler handler)
 {
-    impl->service.post(std::move(handler));
+    impl->schedule(std::move(handler));
 }
 
 void ThreadPool::wait()
@@ -152,6 +467,16 @@ const char* ThreadPool::name() const
     return impl->name();
 }
 
+size_t ThreadPool::threadCount() const
+{
+    return impl->threadCount.load(std::memory_order_relaxed);
+}
+
+ThreadPoolStats ThreadPool::stats() const
+{
+    return impl->stats();
+}
+
 AsioService& ThreadPool::asioService()
 {
     return impl->service;
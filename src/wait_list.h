@@ -0,0 +1,82 @@
+/*
+ * Copyright 2015 Grigory Demchenko (aka gridem)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+namespace synca {
+
+// waiter placed on the stack of the suspended journey
+struct WaitNode
+{
+    DetachableDoer doer;
+    WaitNode* prev = nullptr;
+    WaitNode* next = nullptr;
+    bool linked = false;
+    size_t count = 0; // requested amount: permits, tokens
+};
+
+// intrusive FIFO of waiters, guarded by the owner
+struct WaitList
+{
+    bool empty() const
+    {
+        return head_ == nullptr;
+    }
+
+    WaitNode& front()
+    {
+        return *head_;
+    }
+
+    WaitNode* first()
+    {
+        return head_;
+    }
+
+    void push(WaitNode& node)
+    {
+        node.prev = tail_;
+        node.linked = true;
+        (tail_ ? tail_->next : head_) = &node;
+        tail_ = &node;
+    }
+
+    void remove(WaitNode& node)
+    {
+        (node.prev ? node.prev->next : head_) = node.next;
+        (node.next ? node.next->prev : tail_) = node.prev;
+        node.prev = node.next = nullptr;
+        node.linked = false;
+    }
+
+    // pops the first waiter which acquires its doer
+    // the doer is moved out: the node may be gone after the guard is released
+    boost::optional<DetachableDoer> popAcquired()
+    {
+        while (!empty())
+        {
+            WaitNode& node = front();
+            remove(node);
+            if (node.doer.acquire())
+                return std::move(node.doer);
+        }
+        return boost::none;
+    }
+
+private:
+    WaitNode* head_ = nullptr;
+    WaitNode* tail_ = nullptr;
+};
+
+}
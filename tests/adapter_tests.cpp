@@ -46,6 +46,17 @@ struct MyMutex
     }
 };
 
+int exclusiveLocks = 0;
+int sharedLocks = 0;
+
+struct MySharedMutex
+{
+    void lock()             { ++ exclusiveLocks; }
+    void unlock()           {}
+    void lock_shared()      { ++ sharedLocks; }
+    void unlock_shared()    {}
+};
+
 struct I
 {
     virtual ~I() {}
@@ -70,6 +81,23 @@ struct X : I
 
 DECL_ADAPTER(X, f, get)
 
+struct Z
+{
+    int get() const
+    {
+        return z;
+    }
+
+    void set(int v)
+    {
+        z = v;
+    }
+
+    int z = 0;
+};
+
+DECL_ADAPTER(Z, get, set)
+
 /*
 template<typename T_base> struct Adapter<X, T_base> : private T_base
 {
@@ -158,6 +186,16 @@ TEST(Adapter, 1)
     LOG("val: " << val);
 }
 
+TEST(Adapter, shared)
+{
+    Adapter<Z, BaseSharedLocker<BaseValue<Z>, MySharedMutex>> a;
+    a.set(3);
+    ASSERT_EQ(3, a.get());
+    ASSERT_EQ(3, a.get());
+    ASSERT_EQ(1, exclusiveLocks);
+    ASSERT_EQ(2, sharedLocks);
+}
+
 TEST(Adapter, str)
 {
     std::cout << BOOST_PP_STRINGIZE((DECL_ADAPTER(X, f))) << std::endl;
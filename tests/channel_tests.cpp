@@ -17,6 +17,7 @@
 #include <synca/synca.h>
 #include <synca/log.h>
 #include <synca/channel.h>
+#include <synca/generator.h>
 
 #include "ut.h"
 
@@ -102,4 +103,385 @@ TEST(Channel, stability)
     waitForAll();
 }
 
+TEST(Channel, bounded)
+{
+    ThreadPool tp(4, "ch");
+    scheduler<DefaultTag>().attach(tp);
+    Channel<int> c{2};
+    Atomic<int> putCounter;
+    go([&] {
+        for (int i = 0; i < 10; ++ i)
+        {
+            c.put(i);
+            ++ putCounter;
+        }
+        c.close();
+    });
+    sleepFor(100);
+    ASSERT_EQ(2, putCounter.load());
+    ASSERT_EQ(2u, c.size());
+    go([&] {
+        int i = 0;
+        for (int v: c)
+        {
+            ASSERT_EQ(i++, v);
+            ASSERT_TRUE(c.size() <= 2);
+        }
+        ASSERT_EQ(10, i);
+    });
+    waitForAll();
+    ASSERT_EQ(10, putCounter.load());
+}
+
+TEST(Channel, tryPutGet)
+{
+    Channel<int> c{1};
+    int v = 1;
+    ASSERT_TRUE(c.tryPut(v));
+    v = 2;
+    ASSERT_TRUE(!c.tryPut(v));
+    ASSERT_EQ(2, v);
+    ASSERT_TRUE(c.tryGet(v));
+    ASSERT_EQ(1, v);
+    ASSERT_TRUE(!c.tryGet(v));
+}
+
+TEST(Channel, timeout)
+{
+    ThreadPool tp(4, "ch");
+    scheduler<DefaultTag>().attach(tp);
+    service<TimeoutTag>().attach(tp);
+    Channel<int> c{1};
+    Atomic<int> timedout;
+    go([&] {
+        try
+        {
+            Timeout _(50);
+            c.get();
+        }
+        catch (TimedoutEvent&)
+        {
+            ++ timedout;
+        }
+        c.put(1);
+        try
+        {
+            Timeout _(50);
+            c.put(2);
+        }
+        catch (TimedoutEvent&)
+        {
+            ++ timedout;
+        }
+        // timed out waiters must not take the values
+        int v = 0;
+        ASSERT_TRUE(c.tryGet(v));
+        ASSERT_EQ(1, v);
+        ASSERT_TRUE(!c.tryGet(v));
+    });
+    waitForAll();
+    ASSERT_EQ(2, timedout.load());
+}
+
+TEST(Channel, select)
+{
+    ThreadPool tp(4, "ch");
+    scheduler<DefaultTag>().attach(tp);
+    service<TimeoutTag>().attach(tp);
+    Channel<int> a;
+    Channel<std::string> b;
+    go([&] {
+        int x = 0;
+        std::string s;
+        SelectResult r = select(recv(a, x), recv(b, s), after(50));
+        ASSERT_EQ(2u, r.index);
+
+        b.put("b");
+        r = select(recv(a, x), recv(b, s), after(1000));
+        ASSERT_EQ(1u, r.index);
+        ASSERT_TRUE(r.ok);
+        ASSERT_EQ("b", s);
+
+        go([&] {
+            sleepFor(20);
+            a.put(1);
+        });
+        r = select(recv(a, x), recv(b, s), after(1000));
+        ASSERT_EQ(0u, r.index);
+        ASSERT_EQ(1, x);
+
+        // stale registrations must not take the values
+        b.put("c");
+        ASSERT_EQ("c", b.get());
+
+        b.close();
+        r = select(recv(a, x), recv(b, s));
+        ASSERT_EQ(1u, r.index);
+        ASSERT_TRUE(!r.ok);
+    });
+    waitForAll();
+}
+
+TEST(Channel, selectLost)
+{
+    ThreadPool tp(4, "ch");
+    scheduler<DefaultTag>().attach(tp);
+    service<TimeoutTag>().attach(tp);
+    Channel<int> rare;
+    go([&] {
+        int x = 0;
+        for (int i = 0; i < 100; ++ i)
+            ASSERT_EQ(1u, select(recv(rare, x), after(0)).index);
+        // the lost registrations are removed on return
+        ASSERT_EQ(0u, rare.waiting());
+    });
+    waitForAll();
+}
+
+TEST(Channel, selectEnded)
+{
+    ThreadPool tp(4, "ch");
+    scheduler<DefaultTag>().attach(tp);
+    service<TimeoutTag>().attach(tp);
+    Channel<int> a;
+    go([&] {
+        int x = 0;
+        Goer g = go([] {
+            sleepFor(20);
+        });
+        SelectResult r = select(recv(a, x), ended(g), after(1000));
+        ASSERT_EQ(1u, r.index);
+        ASSERT_EQ(0u, a.waiting());
+        // the ended journey is selected at once
+        r = select(recv(a, x), ended(g));
+        ASSERT_EQ(1u, r.index);
+    });
+    waitForAll();
+}
+
+TEST(Channel, batch)
+{
+    ThreadPool tp(4, "ch");
+    scheduler<DefaultTag>().attach(tp);
+    Channel<int> c{4};
+    Channel<int> d;
+    go([&] {
+        auto _ = closer(c);
+        std::vector<int> vs;
+        for (int i = 0; i < 100; ++ i)
+            vs.push_back(i);
+        c.putMany(vs);
+    });
+    Atomic<size_t> maxBatch;
+    pipingBatch1to1(c, d, [&maxBatch](std::vector<int>& vs) {
+        if (vs.size() > maxBatch)
+            maxBatch.store(vs.size());
+        for (auto&& v: vs)
+            v *= 2;
+        return vs;
+    }, 8);
+    go([&] {
+        std::vector<int> vs;
+        while (d.getBatch(vs, 16))
+        {
+        }
+        ASSERT_EQ(100u, vs.size());
+        for (int i = 0; i < 100; ++ i)
+            ASSERT_EQ(i * 2, vs[i]);
+    });
+    waitForAll();
+    ASSERT_TRUE(maxBatch <= 8u);
+}
+
+// returns the values in the received order
+template<typename T_policy>
+std::vector<int> ringChannelOrder()
+{
+    ThreadPool tp(4, "ch");
+    scheduler<DefaultTag>().attach(tp);
+    RingChannel<int, T_policy> c{4};
+    std::vector<int> received;
+    go([&] {
+        for (int i = 0; i < 100; ++ i)
+            c.put(i);
+        c.close();
+    });
+    go([&] {
+        for (int v: c)
+            received.push_back(v);
+    });
+    waitForAll();
+    return received;
+}
+
+std::vector<int> sequence(int n)
+{
+    std::vector<int> res;
+    for (int i = 0; i < n; ++ i)
+        res.push_back(i);
+    return res;
+}
+
+TEST(RingChannel, spsc)
+{
+    ASSERT_TRUE(ringChannelOrder<Spsc>() == sequence(100));
+}
+
+TEST(RingChannel, mpsc)
+{
+    ASSERT_TRUE(ringChannelOrder<Mpsc>() == sequence(100));
+}
+
+TEST(RingChannel, mpmc)
+{
+    ASSERT_TRUE(ringChannelOrder<Mpmc>() == sequence(100));
+}
+
+TEST(RingChannel, cancel)
+{
+    ThreadPool tp(4, "ch");
+    scheduler<DefaultTag>().attach(tp);
+    RingChannel<int> c{2};
+    go([&] {
+        c.get();
+    }).cancel();
+    go([&] {
+        c.put(1);
+        c.put(2);
+        c.put(3);
+    }).cancel();
+    waitForAll();
+}
+
+TEST(RingChannel, stability)
+{
+    ThreadPool tp(threadConcurrency(), "ch");
+    scheduler<DefaultTag>().attach(tp);
+
+    constexpr int producers = 4;
+    constexpr int consumers = 4;
+    constexpr int items = 20000;
+
+    RingChannel<int> c{16};
+    Atomic<int> produced;
+    Atomic<int64_t> sum;
+    for (int i = 0; i < producers; ++ i)
+    {
+        go([&] {
+            for (int v = 1; v <= items; ++ v)
+                c.put(v);
+            if (++ produced == producers)
+                c.close();
+        });
+    }
+    for (int i = 0; i < consumers; ++ i)
+    {
+        go([&] {
+            for (int v: c)
+                sum += v;
+        });
+    }
+    waitForAll();
+    ASSERT_EQ(int64_t(producers) * items * (items + 1) / 2, sum.load());
+}
+
+TEST(Generator, lazy)
+{
+    int produced = 0;
+    Generator<int> g([&](Generator<int>::Yield& yield) {
+        for (int i = 0; i < 5; ++ i)
+        {
+            ++ produced;
+            yield(i);
+        }
+    });
+    ASSERT_EQ(0, produced);
+    int v;
+    ASSERT_TRUE(g.get(v));
+    ASSERT_EQ(0, v);
+    ASSERT_EQ(1, produced);
+    int sum = 0;
+    for (int x: g)
+        sum += x;
+    ASSERT_EQ(1 + 2 + 3 + 4, sum);
+    ASSERT_TRUE(!g.get(v));
+}
+
+TEST(Generator, error)
+{
+    Generator<int> g([](Generator<int>::Yield& yield) {
+        yield(1);
+        throw std::runtime_error("gen");
+    });
+    int v;
+    ASSERT_TRUE(g.get(v));
+    bool thrown = false;
+    try
+    {
+        g.get(v);
+    }
+    catch (std::runtime_error&)
+    {
+        thrown = true;
+    }
+    ASSERT_TRUE(thrown);
+    ASSERT_TRUE(!g.get(v));
+}
+
+TEST(Generator, unwind)
+{
+    int alive = 0;
+    struct Guard
+    {
+        int& n;
+        explicit Guard(int& n_) : n(n_) { ++ n; }
+        ~Guard()                        { -- n; }
+    };
+    {
+        Generator<int> g([&](Generator<int>::Yield& yield) {
+            Guard guard{alive};
+            for (int i = 0;; ++ i)
+                yield(i);
+        });
+        int v;
+        ASSERT_TRUE(g.get(v));
+        ASSERT_EQ(1, alive);
+    }
+    ASSERT_EQ(0, alive);
+    {
+        Generator<int> g([&](Generator<int>::Yield&) {
+            ++ alive;
+        });
+    }
+    ASSERT_EQ(0, alive);
+}
+
+TEST(Generator, piping)
+{
+    ThreadPool tp(2, "gen");
+    scheduler<DefaultTag>().attach(tp);
+    service<TimeoutTag>().attach(tp);
+    Generator<int> g([](Generator<int>::Yield& yield) {
+        for (int i = 0; i < 20; ++ i)
+        {
+            if (i == 10)
+                sleepFor(1); // journey operations are allowed inside
+            yield(i);
+        }
+    });
+    Channel<int> c;
+    piping1to1(g, c, [](int v) { return v * 10; });
+    Atomic<int> sum;
+    go([&] {
+        std::vector<int> vs;
+        while (c.getBatch(vs, 4))
+        {
+        }
+        for (int v: vs)
+            sum += v;
+    });
+    waitForAll();
+    ASSERT_EQ(190 * 10, sum.load());
+}
+
 CPPUT_TEST_MAIN
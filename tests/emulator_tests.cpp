@@ -39,10 +39,10 @@ struct NullListener
             JLOG("accepted for node " << id);
             while (true)
             {
-                size_t sz = -1;
-                s.read(podToView(sz));
-                VERIFY(sz < 10 * 1024 * 1024, "Invalid message size");
-                Buffer buf(sz);
+                PacketHeader header;
+                s.read(podToView(header));
+                VERIFY(header.size < 10 * 1024 * 1024, "Invalid message size");
+                Buffer buf(header.size);
                 s.read(bufToView(buf));
                 JLOG("+1 message for " << id);
                 ++ single<ResponsesCount>()[id];
@@ -212,6 +212,8 @@ int main(int argc, const char* argv[])
         scheduler<DefaultTag>().attach(tp);
         service<NetworkTag>().attach(tp);
         service<TimeoutTag>().attach(tp);
+        ThreadPool codec(2, "codec");
+        scheduler<CodecTag>().attach(codec);
 
         single<NodesConfig>().setThisNode(id);
         MCleanup {
@@ -33,6 +33,123 @@ TEST(Mutex, 1)
     waitForAll();
 }
 
+TEST(Mutex, cancelWaiter)
+{
+    ThreadPool tp(4, "ch");
+    scheduler<DefaultTag>().attach(tp);
+    service<TimeoutTag>().attach(tp);
+    Mutex m;
+    Atomic<int> state;
+    go([&] {
+        Lock _{m};
+        auto waiter = go([&] {
+            Lock _{m};
+            state.store(1);
+        });
+        go([&] {
+            Lock _{m};
+            state.store(2);
+        });
+        sleepFor(10);
+        waiter.cancel();
+        sleepFor(10);
+    });
+    waitForAll();
+    ASSERT_EQ(2, state.load());
+}
+
+TEST(Mutex, spin)
+{
+    ThreadPool tp(threadConcurrency(), "ch");
+    scheduler<DefaultTag>().attach(tp);
+    Mutex m{100};
+    int counter = 0;
+    for (int i = 0; i < 8; ++ i)
+    {
+        go([&] {
+            for (int j = 0; j < 10000; ++ j)
+            {
+                Lock _{m};
+                ++ counter;
+            }
+        });
+    }
+    waitForAll();
+    ASSERT_EQ(80000, counter);
+}
+
+TEST(SharedMutex, readersWriters)
+{
+    ThreadPool tp(threadConcurrency(), "ch");
+    scheduler<DefaultTag>().attach(tp);
+    SharedMutex m;
+    Atomic<int> readers;
+    Atomic<int> maxReaders;
+    int value = 0;
+    for (int i = 0; i < 8; ++ i)
+    {
+        go([&] {
+            for (int j = 0; j < 1000; ++ j)
+            {
+                {
+                    SharedLock _{m};
+                    int r = ++ readers;
+                    if (r > maxReaders)
+                        maxReaders.store(r);
+                    ASSERT_EQ(0, value % 2);
+                    reschedule();
+                    -- readers;
+                }
+                if (j % 10 == 0)
+                {
+                    std::unique_lock<SharedMutex> _{m};
+                    ASSERT_EQ(0, readers.load());
+                    ++ value;
+                    reschedule();
+                    ++ value;
+                }
+            }
+        });
+    }
+    waitForAll();
+    ASSERT_EQ(8 * 100 * 2, value);
+    ASSERT_TRUE(maxReaders.load() > 1);
+}
+
+TEST(SharedMutex, writerPreference)
+{
+    ThreadPool tp(4, "ch");
+    scheduler<DefaultTag>().attach(tp);
+    service<TimeoutTag>().attach(tp);
+    SharedMutex m;
+    std::vector<int> order;
+    Mutex orderMutex;
+    auto push = [&](int v) {
+        Lock _{orderMutex};
+        order.push_back(v);
+    };
+    go([&] {
+        SharedLock _{m};
+        go([&] {
+            std::unique_lock<SharedMutex> _{m};
+            push(1);
+        });
+        sleepFor(10);
+        go([&] {
+            SharedLock _{m};
+            push(2);
+        });
+        go([&] {
+            SharedLock _{m};
+            push(2);
+        });
+        sleepFor(10);
+    });
+    waitForAll();
+    ASSERT_EQ(3u, order.size());
+    ASSERT_EQ(1, order[0]);
+}
+
 TEST(Channel, stability)
 {
     ThreadPool tp(threadConcurrency(), "ch");
@@ -86,6 +86,23 @@ TEST(Network, ListenWriteFail)
 }
 */
 
+TEST(Network, TryConnectFail)
+{
+    ThreadPool tp(1, "net");
+    scheduler<DefaultTag>().attach(tp);
+    service<NetworkTag>().attach(tp);
+
+    go([&] {
+        Socket s;
+        auto r = s.tryConnect(Endpoint{8801, "127.0.0.1", Endpoint::Type::V4});
+        ASSERT_TRUE(r.status() == Status::Failed);
+        ASSERT_TRUE(!r.error().empty());
+        int v = 0;
+        ASSERT_TRUE(s.tryWrite(podToView(v)).status() == Status::Failed);
+    });
+    waitForAll();
+}
+
 TEST(Network, NodeDisconnect)
 {
     ThreadPool tp(1, "net");
@@ -0,0 +1,202 @@
+/*
+ * Copyright 2015 Grigory Demchenko (aka gridem)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <synca/synca.h>
+#include <synca/log.h>
+#include <synca/semaphore.h>
+
+#include "ut.h"
+
+#include <chrono>
+
+using namespace synca;
+
+TEST(Semaphore, limit)
+{
+    ThreadPool tp(threadConcurrency(), "sem");
+    scheduler<DefaultTag>().attach(tp);
+    Semaphore s{3};
+    Atomic<int> inflight;
+    Atomic<int> maxInflight;
+    for (int i = 0; i < 16; ++ i)
+    {
+        go([&] {
+            for (int j = 0; j < 100; ++ j)
+            {
+                SemaphoreGuard _{s};
+                int v = ++ inflight;
+                if (v > maxInflight)
+                    maxInflight.store(v);
+                reschedule();
+                -- inflight;
+            }
+        });
+    }
+    waitForAll();
+    ASSERT_TRUE(maxInflight.load() <= 3);
+    ASSERT_EQ(3u, s.available());
+}
+
+TEST(Semaphore, fairness)
+{
+    ThreadPool tp(1, "sem");
+    scheduler<DefaultTag>().attach(tp);
+    service<TimeoutTag>().attach(tp);
+    Semaphore fifo{0};
+    Semaphore barging{0, Fairness::Barging};
+    bool big = false;
+    bool small = false;
+    go([&] {
+        go([&] { fifo.acquire(2); big = true; });
+        go([&] { fifo.acquire(1); small = true; });
+        go([&] { barging.acquire(2); });
+        go([&] { barging.acquire(1); });
+        sleepa(10);
+        fifo.release(1);
+        barging.release(1);
+        sleepa(10);
+        // the head waits for 2 permits and blocks the rest
+        ASSERT_TRUE(!big && !small);
+        ASSERT_EQ(1u, fifo.available());
+        // the smaller request overtakes
+        ASSERT_EQ(0u, barging.available());
+        fifo.release(2);
+        barging.release(2);
+    });
+    waitForAll();
+    ASSERT_TRUE(big && small);
+    ASSERT_TRUE(!fifo.tryAcquire(1));
+}
+
+TEST(Semaphore, cancel)
+{
+    ThreadPool tp(2, "sem");
+    scheduler<DefaultTag>().attach(tp);
+    service<TimeoutTag>().attach(tp);
+    Semaphore s{1};
+    bool acquired = false;
+    go([&] {
+        s.acquire(1);
+        auto g = go([&] { s.acquire(2); });
+        go([&] { s.acquire(1); acquired = true; });
+        sleepa(10);
+        g.cancel();
+        sleepa(10);
+        ASSERT_TRUE(!acquired);
+        s.release(1);
+    });
+    waitForAll();
+    ASSERT_TRUE(acquired);
+}
+
+TEST(RateLimiter, rate)
+{
+    ThreadPool tp(2, "rl");
+    scheduler<DefaultTag>().attach(tp);
+    service<TimeoutTag>().attach(tp);
+    for (auto fairness: {Fairness::Fifo, Fairness::Barging})
+    {
+        RateLimiter r{200, 10, fairness};
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 4; ++ i)
+        {
+            go([&] {
+                for (int j = 0; j < 10; ++ j)
+                    r.acquire();
+            });
+        }
+        waitForAll();
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        // 40 tokens: 10 from the burst, 30 at 200 per second
+        ASSERT_TRUE(ms >= 140);
+    }
+    RateLimiter r{1, 2};
+    ASSERT_TRUE(r.tryAcquire(2));
+    ASSERT_TRUE(!r.tryAcquire(1));
+}
+
+TEST(RateLimiter, overBurst)
+{
+    ThreadPool tp(2, "rl");
+    scheduler<DefaultTag>().attach(tp);
+    service<TimeoutTag>().attach(tp);
+    for (auto fairness: {Fairness::Fifo, Fairness::Barging})
+    {
+        RateLimiter r{200, 10, fairness};
+        ASSERT_TRUE(!r.tryAcquire(20));
+        auto start = std::chrono::steady_clock::now();
+        go([&] {
+            r.acquire(20);
+        });
+        waitForAll();
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        // 20 tokens: 10 from the burst, 10 at 200 per second
+        ASSERT_TRUE(ms >= 40);
+        ASSERT_TRUE(ms < 1000);
+    }
+}
+
+TEST(Latch, wait)
+{
+    ThreadPool tp(4, "latch");
+    scheduler<DefaultTag>().attach(tp);
+    Latch l{8};
+    Atomic<int> done;
+    Atomic<int> passed;
+    for (int i = 0; i < 4; ++ i)
+    {
+        go([&] {
+            l.wait();
+            ASSERT_EQ(8, done.load());
+            ++ passed;
+        });
+    }
+    for (int i = 0; i < 8; ++ i)
+    {
+        go([&] {
+            ++ done;
+            l.countDown();
+        });
+    }
+    waitForAll();
+    ASSERT_EQ(4, passed.load());
+    ASSERT_TRUE(l.tryWait());
+}
+
+TEST(Barrier, phases)
+{
+    ThreadPool tp(4, "barrier");
+    scheduler<DefaultTag>().attach(tp);
+    const int parties = 5;
+    Barrier b{parties};
+    Atomic<int> phase[3];
+    for (int i = 0; i < parties; ++ i)
+    {
+        go([&] {
+            for (int p = 0; p < 3; ++ p)
+            {
+                ++ phase[p];
+                b.arriveAndWait();
+                ASSERT_EQ(parties, phase[p].load());
+            }
+        });
+    }
+    waitForAll();
+}
+
+CPPUT_TEST_MAIN
@@ -45,4 +45,754 @@ TEST(Serialize, handler)
     showBuffer(buf);
 }
 
+struct Vote
+{
+    int term;
+    char granted;
+    double weight;
+};
+
+TEST(Serialize, flat)
+{
+    View v = serialize(-1);
+    ASSERT_EQ(v.size, c_intSize + sizeof(ImageTrailer));
+    Buffer buf;
+    bufInsertView(buf, serialize(Vote{3, 1, 0.5}));
+    ASSERT_EQ(buf.size(), sizeof(Vote) + sizeof(ImageTrailer));
+    auto& vote = deserialize<Vote>(buf);
+    ASSERT_EQ(vote.term, 3);
+    ASSERT_EQ(vote.granted, 1);
+    ASSERT_EQ(vote.weight, 0.5);
+}
+
+TEST(Serialize, arenaScope)
+{
+    MemoryAllocator a;
+    auto p = arenaNew(a, 5);
+    ASSERT_EQ(*p, 5);
+    ASSERT_EQ(a.size(), c_ptrSize);
+    std::unique_ptr<int> heap{new int{1}};
+    ASSERT_EQ(a.size(), c_ptrSize);
+}
+
+#ifdef flagARENA_NEW
+TEST(Serialize, handlerCapture)
+{
+    std::string s(100, 'x');
+    int sum = 0;
+    Buffer buf;
+    bufInsertView(buf, serialize(Handler([s, &sum] { sum += s.size(); })));
+    deserialize<Handler>(buf)();
+    ASSERT_EQ(sum, 100);
+}
+
+TEST(Serialize, relocation)
+{
+    std::map<int, std::string> m;
+    for (int i = 0; i < 100; ++ i)
+        m[i] = std::string(i, 'a');
+    size_t total = 0;
+    Buffer buf;
+    bufInsertView(buf, serialize(Handler([m, &total] {
+        for (auto&& e: m)
+            total += e.first + e.second.size();
+    })));
+    deserialize<Handler>(buf)();
+    ASSERT_EQ(total, 9900u);
+}
+
+TEST(Serialize, arenaGrow)
+{
+    std::string s(c_arenaInitialSize * 4, 'x');
+    size_t size = 0;
+    Buffer buf;
+    bufInsertView(buf, serialize(Handler([s, &size] { size = s.size(); })));
+    ASSERT_TRUE(tlsArena().size > c_arenaInitialSize);
+    deserialize<Handler>(buf)();
+    ASSERT_EQ(size, s.size());
+}
+#endif
+
+struct Point
+{
+    int x;
+    double y;
+};
+
+struct Record
+{
+    int id = 0;
+    std::string name;
+    std::vector<std::string> tags;
+    std::map<int, std::vector<int>> groups;
+    std::unordered_map<std::string, Point> points;
+    std::set<int> ids;
+    boost::optional<std::string> note;
+    boost::optional<int> missing;
+
+    template<typename V>
+    void serializeFields(V& v)
+    {
+        v(id, name, tags, groups, points, ids, note, missing);
+    }
+};
+
+TEST(Serialize, value)
+{
+    Buffer buf;
+    serializeValue(buf, 42);
+    ASSERT_EQ(buf.size(), sizeof(int));
+    ASSERT_EQ(deserializeValue<int>(bufToView(buf)), 42);
+}
+
+TEST(Serialize, fields)
+{
+    Record r;
+    r.id = 7;
+    r.name = "record";
+    r.tags = {"a", "", "ccc"};
+    r.groups[1] = {1, 2, 3};
+    r.groups[5] = {};
+    r.points["p"] = Point{1, 2.5};
+    r.ids = {3, 1, 2};
+    r.note = std::string{"note"};
+
+    Buffer buf;
+    serializeValue(buf, r);
+    auto d = deserializeValue<Record>(bufToView(buf));
+    ASSERT_EQ(d.id, 7);
+    ASSERT_EQ(d.name, "record");
+    ASSERT_EQ(d.tags.size(), 3u);
+    ASSERT_EQ(d.tags[2], "ccc");
+    ASSERT_EQ(d.groups.size(), 2u);
+    ASSERT_EQ(d.groups[1].size(), 3u);
+    ASSERT_EQ(d.groups[1][2], 3);
+    ASSERT_EQ(d.points["p"].y, 2.5);
+    ASSERT_EQ(d.ids.size(), 3u);
+    ASSERT_TRUE(d.note);
+    ASSERT_EQ(*d.note, "note");
+    ASSERT_FALSE(d.missing);
+}
+
+bool failsToRead(Buffer& buf)
+{
+    try
+    {
+        deserializeValue<std::string>(bufToView(buf));
+    }
+    catch (std::exception&)
+    {
+        return true;
+    }
+    return false;
+}
+
+TEST(Serialize, truncated)
+{
+    Buffer buf;
+    serializeValue(buf, std::string{"truncated"});
+    ASSERT_FALSE(failsToRead(buf));
+    buf.pop_back();
+    ASSERT_TRUE(failsToRead(buf));
+    buf.push_back('d');
+    buf.push_back('x');
+    ASSERT_TRUE(failsToRead(buf));
+}
+
+TEST(Serialize, handlerValue)
+{
+    std::string captured = "captured";
+    std::string seen;
+    std::vector<Handler> hs = {[captured, &seen] { seen = captured; }};
+    Buffer buf;
+    serializeValue(buf, hs);
+    auto read = deserializeValue<std::vector<Handler>>(bufToView(buf));
+    ASSERT_EQ(read.size(), 1u);
+    read[0]();
+    ASSERT_EQ(seen, captured);
+}
+
+template<typename T>
+bool failsToReadAs(const Buffer& buf)
+{
+    try
+    {
+        deserializeValue<T>({(Ptr)buf.data(), buf.size()});
+    }
+    catch (std::exception&)
+    {
+        return true;
+    }
+    return false;
+}
+
+TEST(Serialize, corruptedSize)
+{
+    // the size is checked against the data left before the allocation
+    Buffer buf;
+    bufInsertPod(buf, uint32_t(0xfffffff0));
+    bufInsertPod(buf, uint64_t(1));
+    ASSERT_TRUE(failsToReadAs<std::string>(buf));
+    ASSERT_TRUE(failsToReadAs<std::vector<uint64_t>>(buf));
+    ASSERT_TRUE(failsToReadAs<std::vector<std::string>>(buf));
+}
+
+TEST(Serialize, bulk)
+{
+    std::vector<Point> points = {{1, 1.5}, {2, 2.5}};
+    Buffer buf;
+    serializeValue(buf, points);
+    ASSERT_EQ(buf.size(), sizeof(uint32_t) + 2 * sizeof(Point));
+    auto d = deserializeValue<std::vector<Point>>(bufToView(buf));
+    ASSERT_EQ(d[1].x, 2);
+    ASSERT_EQ(d[1].y, 2.5);
+
+    buf.clear();
+    serializeValue(buf, std::vector<bool>{true, false, true});
+    auto b = deserializeValue<std::vector<bool>>(bufToView(buf));
+    ASSERT_EQ(b.size(), 3u);
+    ASSERT_TRUE(b[2]);
+}
+
+int g_pings = 0;
+
+struct Ping
+{
+    static constexpr MsgTypeId msgType = 100;
+
+    int count;
+    std::string from;
+
+    template<typename V>
+    void serializeFields(V& v)
+    {
+        v(count, from);
+    }
+
+    void operator()()
+    {
+        g_pings += count;
+    }
+};
+
+REGISTER_MSG(Ping)
+
+TEST(Serialize, registeredMsg)
+{
+    auto b = serializeMsgToPacket(Ping{3, "node1"});
+    PacketHeader header;
+    std::memcpy(&header, b.data(), sizeof(header));
+    ASSERT_EQ(header.type, Ping::msgType);
+    ASSERT_EQ(header.size, b.size() - sizeof(header));
+    dispatchMsg(header.type, {b.data() + sizeof(header), header.size});
+    ASSERT_EQ(g_pings, 3);
+    ASSERT_TRUE(detail::HasMsgType<Ping>::value);
+    ASSERT_FALSE(detail::HasMsgType<Record>::value);
+}
+
+bool failsToDispatch(MsgTypeId type)
+{
+    try
+    {
+        dispatchMsg(type, {nullptr, 0});
+    }
+    catch (std::exception&)
+    {
+        return true;
+    }
+    return false;
+}
+
+TEST(Serialize, unknownMsg)
+{
+    ASSERT_TRUE(failsToDispatch(101));
+    ASSERT_TRUE(failsToDispatch(c_maxMsgType));
+}
+
+using Frames = std::vector<Buffer>;
+
+FrameWriter framesWriter(Frames& frames)
+{
+    return [&frames](std::initializer_list<View> views) {
+        Buffer frame;
+        for (auto&& v: views)
+            bufInsertView(frame, v);
+        frames.push_back(std::move(frame));
+    };
+}
+
+// reads the frames consequently as the socket does
+void receiveFrames(const Frames& frames, uint64_t maxReassembled = c_maxReassembledSize)
+{
+    Buffer wire;
+    for (auto&& f: frames)
+        wire.insert(wire.end(), f.begin(), f.end());
+    size_t offset = 0;
+    PacketReceiver receiver{[&](View v) {
+        VERIFY(offset + v.size <= wire.size(), "Read beyond the wire");
+        std::memcpy(v.data, wire.data() + offset, v.size);
+        offset += v.size;
+    }, maxReassembled};
+    while (offset < wire.size())
+        receiver.receive();
+}
+
+void receiveAll(const Frames& frames)
+{
+    ThreadPool tp(1, "receive"); // for stats registration
+    scheduler<DefaultTag>().attach(tp);
+    receiveFrames(frames);
+}
+
+TEST(Fragment, interleave)
+{
+    std::string big1(c_fragmentSize * 3 + 10, 'a');
+    std::string big2(c_fragmentSize * 2, 'b');
+    size_t received = 0;
+    Handler h1 = [big1, &received] { received += big1.size(); };
+    Handler h2 = [big2, &received] { received += big2.size(); };
+    Frames frames1, frames2;
+    auto packet1 = serializeToPacket(h1);
+    auto packet2 = serializeToPacket(h2);
+    writePacket(framesWriter(frames1), bufToView(packet1));
+    writePacket(framesWriter(frames2), bufToView(packet2));
+    ASSERT_EQ(frames1.size(), 4u);
+    ASSERT_EQ(frames2.size(), 3u);
+
+    Frames wire;
+    auto ping = serializeMsgToPacket(Ping{1, "small"});
+    writePacket(framesWriter(wire), bufToView(ping));
+    ASSERT_EQ(wire.size(), 1u);
+    ASSERT_EQ(wire[0].size(), ping.size());
+    for (size_t i = 0; i < frames1.size(); ++ i)
+    {
+        wire.push_back(frames1[i]);
+        if (i < frames2.size())
+            wire.push_back(frames2[i]);
+        writePacket(framesWriter(wire), bufToView(ping));
+    }
+
+    g_pings = 0;
+    receiveAll(wire);
+    ASSERT_EQ(received, big1.size() + big2.size());
+    ASSERT_EQ(g_pings, 5);
+}
+
+struct CountingSink : IStreamSink
+{
+    CountingSink(size_t& bytes, bool& done) : bytes_{bytes}, done_{done} {}
+
+    void write(View chunk) override
+    {
+        bytes_ += chunk.size;
+    }
+
+    void done() override
+    {
+        done_ = true;
+    }
+
+private:
+    size_t& bytes_;
+    bool& done_;
+};
+
+// the registry is global thus the sink state outlives the test
+size_t g_sinkBytes = 0;
+bool g_sinkDone = false;
+
+TEST(Fragment, sink)
+{
+    g_sinkBytes = 0;
+    g_sinkDone = false;
+    registerStreamSink(200, [](uint64_t) {
+        return std::unique_ptr<IStreamSink>(new CountingSink{g_sinkBytes, g_sinkDone});
+    });
+    Buffer chunk(c_fragmentSize);
+    uint64_t total = c_fragmentSize * 5 / 2;
+    uint64_t left = total;
+    Frames frames;
+    writeStream(framesWriter(frames), 200, total, [&] {
+        View v{chunk.data(), std::min<uint64_t>(left, chunk.size())};
+        left -= v.size;
+        return v;
+    });
+    ASSERT_EQ(frames.size(), 3u);
+    receiveAll(frames);
+    ASSERT_EQ(g_sinkBytes, total);
+    ASSERT_TRUE(g_sinkDone);
+}
+
+bool failsToReassemble(const Frames& frames, uint64_t maxReassembled)
+{
+    try
+    {
+        receiveFrames(frames, maxReassembled);
+    }
+    catch (std::exception&)
+    {
+        return true;
+    }
+    return false;
+}
+
+TEST(Fragment, reassemblyLimit)
+{
+    ThreadPool tp(1, "receive"); // for stats registration
+    scheduler<DefaultTag>().attach(tp);
+    std::string big1(c_fragmentSize * 2, 'a');
+    std::string big2(c_fragmentSize * 2, 'b');
+    Handler h1 = [big1] {};
+    Handler h2 = [big2] {};
+    Frames frames1, frames2;
+    auto packet1 = serializeToPacket(h1);
+    auto packet2 = serializeToPacket(h2);
+    writePacket(framesWriter(frames1), bufToView(packet1));
+    writePacket(framesWriter(frames2), bufToView(packet2));
+    Frames sequential = frames1;
+    sequential.insert(sequential.end(), frames2.begin(), frames2.end());
+    Frames interleaved = {frames1[0], frames2[0]};
+    uint64_t limit = packet1.size() + c_fragmentSize;
+    ASSERT_TRUE(!failsToReassemble(sequential, limit));
+    ASSERT_TRUE(failsToReassemble(interleaved, limit));
+    ASSERT_TRUE(!failsToReassemble(interleaved, 2 * limit));
+}
+
+TEST(Fragment, pooled)
+{
+    Frames frames;
+    size_t received = 0;
+    for (size_t i = 0; i < 20; ++ i)
+    {
+        auto ping = serializeMsgToPacket(Ping{1, std::string(i * 100, 'p')});
+        writePacket(framesWriter(frames), bufToView(ping));
+        std::string s(i * 50, 'h');
+        Handler h = [s, &received] { received += s.size(); };
+        auto packet = serializeToPacket(h);
+        writePacket(framesWriter(frames), bufToView(packet));
+    }
+    g_pings = 0;
+    receiveAll(frames);
+    ASSERT_EQ(g_pings, 20);
+    ASSERT_EQ(received, 50u * 190);
+}
+
+TEST(Compression, lz)
+{
+    auto codec = findCodec(c_lzCodec);
+    ASSERT_TRUE(codec != nullptr);
+    std::vector<std::string> inputs = {"", "a", "abcabcabcabcabcabc", std::string(100000, 'z')};
+    std::string text;
+    for (int i = 0; i < 5000; ++ i)
+        text += "key" + std::to_string(i % 97) + "=value" + std::to_string(i * 7919 % 1000) + ";";
+    inputs.push_back(text);
+    std::string noise;
+    uint32_t seed = 1;
+    for (int i = 0; i < 10000; ++ i)
+    {
+        seed = seed * 1103515245 + 12345;
+        noise += char(seed >> 16);
+    }
+    inputs.push_back(noise);
+    for (auto&& in: inputs)
+    {
+        Buffer src(in.begin(), in.end());
+        Buffer compressed;
+        codec->compress(bufToView(src), compressed);
+        Buffer raw(src.size());
+        codec->decompress(bufToView(compressed), bufToView(raw));
+        ASSERT_TRUE(raw == src);
+    }
+    Buffer src(text.begin(), text.end());
+    Buffer compressed;
+    codec->compress(bufToView(src), compressed);
+    ASSERT_TRUE(compressed.size() * 2 < src.size());
+}
+
+TEST(Compression, packet)
+{
+    ThreadPool tp(1, "compress"); // for stats registration
+    scheduler<DefaultTag>().attach(tp);
+    std::string value(10000, 'v');
+    size_t received = 0;
+    Handler h = [value, &received] { received += value.size(); };
+    auto small = serializeMsgToPacket(Ping{1, "small"});
+    setCompression(c_lzCodec, 1024);
+    auto packet = compressPacket(serializeToPacket(h));
+    auto ping = compressPacket(small);
+    setCompression(c_noCodec);
+
+    PacketHeader header;
+    std::memcpy(&header, packet.data(), sizeof(header));
+    ASSERT_TRUE((header.flags & c_flagCompressed) != 0);
+    ASSERT_TRUE(packet.size() < value.size() / 4);
+    ASSERT_TRUE(ping == small);
+
+    Frames frames;
+    writePacket(framesWriter(frames), bufToView(packet));
+    writePacket(framesWriter(frames), bufToView(ping));
+    g_pings = 0;
+    receiveAll(frames);
+    ASSERT_EQ(received, value.size());
+    ASSERT_EQ(g_pings, 1);
+}
+
+TEST(Frame, crc32c)
+{
+    std::string check = "123456789";
+    View v{(Ptr)check.data(), check.size()};
+    ASSERT_EQ(crc32c(v), 0xE3069283u);
+    ASSERT_EQ(detail::crc32cSoftware(v, 0), 0xE3069283u);
+    ASSERT_EQ(crc32c({v.data + 4, 5}, crc32c({v.data, 4})), 0xE3069283u);
+
+    std::string odd(1001, 'z'); // unaligned tail for the hardware version
+    View o{(Ptr)odd.data(), odd.size()};
+    ASSERT_EQ(crc32c(o), detail::crc32cSoftware(o, 0));
+}
+
+bool failsToReceive(const Frames& frames)
+{
+    try
+    {
+        receiveAll(frames);
+        return false;
+    }
+    catch (std::exception&)
+    {
+        return true;
+    }
+}
+
+TEST(Frame, corrupted)
+{
+    auto ping = serializeMsgToPacket(Ping{1, "frame"});
+    Frames frames;
+    writePacket(framesWriter(frames), bufToView(ping));
+    g_pings = 0;
+    ASSERT_FALSE(failsToReceive(frames));
+    ASSERT_EQ(g_pings, 1);
+
+    Frames corrupted = frames;
+    corrupted[0].back() ^= 1;
+    ASSERT_TRUE(failsToReceive(corrupted));
+
+    Frames version = frames;
+    PacketHeader header;
+    std::memcpy(&header, version[0].data(), sizeof(header));
+    header.version = c_protocolVersion + 1;
+    std::memcpy(version[0].data(), &header, sizeof(header));
+    ASSERT_TRUE(failsToReceive(version));
+    ASSERT_EQ(g_pings, 1);
+}
+
+struct ThreadNameSink : IStreamSink
+{
+    ThreadNameSink(std::string& writer, std::string& finisher) : writer_{writer}, finisher_{finisher} {}
+
+    void write(View) override
+    {
+        writer_ = name();
+    }
+
+    void done() override
+    {
+        finisher_ = name();
+    }
+
+private:
+    std::string& writer_;
+    std::string& finisher_;
+};
+
+std::string g_sinkWriter;
+std::string g_sinkFinisher;
+
+TEST(Codec, stage)
+{
+    ThreadPool consensus(1, "consensus");
+    ThreadPool codec(2, "codec");
+    scheduler<DefaultTag>().attach(consensus);
+    scheduler<CodecTag>().attach(codec);
+
+    std::string executor, encoder;
+    g_sinkWriter.clear();
+    g_sinkFinisher.clear();
+    registerStreamSink(201, [](uint64_t) {
+        return std::unique_ptr<IStreamSink>(new ThreadNameSink{g_sinkWriter, g_sinkFinisher});
+    });
+    Handler h = [&executor] { executor = name(); };
+    auto packet = serializeToPacket(h);
+    Buffer chunk(c_fragmentSize);
+    Frames frames;
+    writePacket(framesWriter(frames), bufToView(packet));
+    writeStream(framesWriter(frames), 201, chunk.size(), [&] {
+        return bufToView(chunk);
+    });
+    Frames corrupted = frames;
+    corrupted[0].back() ^= 1;
+
+    bool failed = false;
+    std::string failedOn;
+    go([&] {
+        runOnCodec([&] {
+            encoder = name();
+        });
+        receiveFrames(frames);
+        try
+        {
+            receiveFrames(corrupted);
+        }
+        catch (std::exception&)
+        {
+            failed = true;
+            failedOn = name();
+        }
+    });
+    waitForAll();
+    scheduler<CodecTag>().detach();
+    ASSERT_EQ(encoder, "codec");
+    ASSERT_EQ(executor, "consensus");
+    ASSERT_EQ(g_sinkWriter, "codec");
+    ASSERT_EQ(g_sinkFinisher, "consensus");
+    ASSERT_TRUE(failed);
+    ASSERT_EQ(failedOn, "consensus");
+}
+
+TEST(Codec, cancel)
+{
+    ThreadPool consensus(1, "consensus");
+    ThreadPool codec(1, "codec");
+    scheduler<DefaultTag>().attach(consensus);
+    scheduler<CodecTag>().attach(codec);
+
+    Atomic<bool> started, cancelled;
+    std::string encoder, cancelledOn;
+    Goer g = go([&] {
+        started.store(true);
+        // the event is pending on entering the codec
+        while (!cancelled.load())
+            sleepFor(1);
+        try
+        {
+            runOnCodec([&] {
+                encoder = name();
+            });
+        }
+        catch (CancelledEvent&)
+        {
+            cancelledOn = name();
+        }
+    });
+    while (!started.load())
+        sleepFor(1);
+    g.cancel();
+    cancelled.store(true);
+    waitForAll();
+    scheduler<CodecTag>().detach();
+    ASSERT_EQ(encoder, "codec");
+    ASSERT_EQ(cancelledOn, "consensus");
+}
+
+Outbox::Packet packetOf(Handler h)
+{
+    return std::make_shared<Buffer>(serializeToPacket(h));
+}
+
+TEST(Outbox, order)
+{
+    std::vector<int> order;
+    Frames frames;
+    Outbox outbox{framesWriter(frames)};
+    std::vector<Outbox::SlotPtr> slots;
+    for (int i = 0; i < 4; ++ i)
+        slots.push_back(outbox.reserve());
+    // the encoding completes out of order
+    for (int i: {2, 0, 3, 1})
+    {
+        outbox.fill(slots[i], packetOf([i, &order] { order.push_back(i); }));
+        if (i == 2)
+            ASSERT_TRUE(frames.empty());
+    }
+    receiveAll(frames);
+    ASSERT_TRUE(order == (std::vector<int>{0, 1, 2, 3}));
+}
+
+TEST(Outbox, interleave)
+{
+    std::vector<int> order;
+    Frames frames;
+    Outbox outbox{framesWriter(frames)};
+    std::string big(c_fragmentSize * 3, 'a');
+    auto large = outbox.reserve();
+    auto small = outbox.reserve();
+    outbox.fill(small, packetOf([&order] { order.push_back(2); }));
+    outbox.fill(large, packetOf([big, &order] { order.push_back(1); }));
+    ASSERT_EQ(frames.size(), 5u);
+    receiveAll(frames);
+    // the small packet has waited for the single fragment only
+    ASSERT_TRUE(order == (std::vector<int>{2, 1}));
+}
+
+TEST(Outbox, failure)
+{
+    std::vector<int> order;
+    Frames frames;
+    bool broken = true;
+    Outbox outbox{[&](std::initializer_list<View> views) {
+        if (broken)
+        {
+            broken = false;
+            throw std::runtime_error("broken connection");
+        }
+        framesWriter(frames)(views);
+    }};
+    auto failedEncoding = outbox.reserve();
+    auto failedWriting = outbox.reserve();
+    auto written = outbox.reserve();
+    outbox.fill(written, packetOf([&order] { order.push_back(3); }));
+    outbox.fill(failedEncoding, nullptr);
+    ASSERT_TRUE(broken);
+    outbox.fill(failedWriting, packetOf([&order] { order.push_back(2); }));
+    receiveAll(frames);
+    ASSERT_TRUE(order == (std::vector<int>{3}));
+}
+
+bool throwsNodeError(const Handler& handler)
+{
+    try
+    {
+        handler();
+    }
+    catch (NodeError&)
+    {
+        return true;
+    }
+    return false;
+}
+
+TEST(Outbox, send)
+{
+    ThreadPool tp(1, "consensus");
+    scheduler<DefaultTag>().attach(tp);
+    bool encoded = false;
+    bool encodedOnReturn = true;
+    bool absent = false;
+    go([&] {
+        Handler noop = [] {};
+        broadcastSerialized([&encoded, noop]() mutable {
+            encoded = true;
+            return serializeToPacket(noop);
+        });
+        // the caller hasn't been suspended, the encoding is spawned
+        encodedOnReturn = encoded;
+        absent = throwsNodeError([] {
+            sendPacket(123, Buffer{});
+        });
+    });
+    waitForAll();
+    ASSERT_FALSE(encodedOnReturn);
+    ASSERT_TRUE(encoded);
+    ASSERT_TRUE(absent);
+}
+
 CPPUT_TEST_MAIN
@@ -0,0 +1,208 @@
+/*
+ * Copyright 2015 Grigory Demchenko (aka gridem)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Serialization benchmark: prints ns/op and bytes/op in JSON to compare
+// the results between commits (build with LOG_DEBUG=OFF, packet
+// serialization logs in debug mode):
+//     serialization_bench [filter] > before.json
+
+#include <synca/synca2.h>
+#include <synca/log.h>
+
+#include <chrono>
+#include <iostream>
+
+using namespace synca;
+
+using Clock = std::chrono::steady_clock;
+
+constexpr auto c_minDuration = std::chrono::milliseconds(200);
+
+struct BenchResult
+{
+    std::string name;
+    double nsPerOp;
+    size_t bytesPerOp;
+    size_t iterations;
+};
+
+std::vector<BenchResult> g_results;
+std::string g_filter;
+
+// runs the operation until the minimal duration is reached
+template<typename F>
+void bench(const std::string& name, size_t bytes, F f)
+{
+    if (name.find(g_filter) == std::string::npos)
+        return;
+    try
+    {
+        f(); // warm up: arena growth, caches
+        size_t iterations = 0;
+        size_t batch = 1;
+        auto start = Clock::now();
+        auto elapsed = Clock::duration::zero();
+        while (elapsed < c_minDuration)
+        {
+            for (size_t i = 0; i < batch; ++ i)
+                f();
+            iterations += batch;
+            batch *= 2;
+            elapsed = Clock::now() - start;
+        }
+        double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+        g_results.push_back({name, ns / iterations, bytes, iterations});
+    }
+    catch (std::exception& e)
+    {
+        LOG("skipped " << name << ": " << e.what());
+    }
+}
+
+Buffer imageOf(View v)
+{
+    Buffer b;
+    bufInsertView(b, v);
+    return b;
+}
+
+// image path: serialize, deserialize (buffer copy + relocation), packet
+template<typename T>
+void benchImage(const std::string& name, const T& obj)
+{
+    Buffer image;
+    try
+    {
+        image = imageOf(serialize(obj));
+    }
+    catch (std::exception& e)
+    {
+        LOG("skipped " << name << ": " << e.what());
+        return;
+    }
+    bench("image/serialize/" + name, image.size(), [&] {
+        serialize(obj);
+    });
+    bench("image/deserialize/" + name, image.size(), [&] {
+        Buffer b = image;
+        deserialize<T>(b);
+    });
+    T copy = obj;
+    bench("image/packet/" + name, image.size() + sizeof(PacketHeader), [&] {
+        serializeToPacket(copy);
+    });
+}
+
+// trait path: serializeValue, deserializeValue
+template<typename T>
+void benchValue(const std::string& name, const T& obj)
+{
+    Buffer value;
+    serializeValue(value, obj);
+    Buffer b;
+    b.reserve(value.size());
+    bench("value/serialize/" + name, value.size(), [&] {
+        b.clear();
+        serializeValue(b, obj);
+    });
+    bench("value/deserialize/" + name, value.size(), [&] {
+        deserializeValue<T>(bufToView(value));
+    });
+}
+
+template<typename T>
+void benchBoth(const std::string& name, const T& obj)
+{
+    benchImage(name, obj);
+    benchValue(name, obj);
+}
+
+struct Vote
+{
+    uint64_t term;
+    uint64_t node;
+    bool granted;
+};
+
+std::vector<std::vector<int>> nested(size_t n)
+{
+    std::vector<std::vector<int>> res(n);
+    for (size_t i = 0; i < n; ++ i)
+        res[i].resize(i % 16, int(i));
+    return res;
+}
+
+std::map<int, std::string> strings(size_t n)
+{
+    std::map<int, std::string> res;
+    for (size_t i = 0; i < n; ++ i)
+        res[i] = std::string(i % 64, 'x');
+    return res;
+}
+
+// replob-like handler: the captured message to apply
+Handler replobHandler(size_t n)
+{
+    auto data = strings(n);
+    MsgId id{1, 2};
+    return [data, id] {
+        JLOG("apply " << id.first << ": " << data.size());
+    };
+}
+
+CarrySet carrySet(size_t n)
+{
+    CarrySet res;
+    for (size_t i = 0; i < n; ++ i)
+        res.insert(CarryMsg2{replobHandler(1), MsgId{1, i}});
+    return res;
+}
+
+void report()
+{
+    std::cout << "{\n  \"benchmarks\": [";
+    bool rest = false;
+    for (auto&& r: g_results)
+    {
+        std::cout << (rest ? ",\n" : "\n") << "    {\"name\": \"" << r.name
+                  << "\", \"ns_per_op\": " << r.nsPerOp
+                  << ", \"bytes_per_op\": " << r.bytesPerOp
+                  << ", \"iterations\": " << r.iterations << "}";
+        rest = true;
+    }
+    std::cout << "\n  ]\n}\n";
+}
+
+int main(int argc, const char* argv[])
+{
+    if (argc > 1)
+        g_filter = argv[1];
+
+    benchBoth("int", 1);
+    benchImage("pod", Vote{1, 2, true});
+    for (size_t n: {16, 1024, 65536})
+        benchBoth("string/" + std::to_string(n), std::string(n, 'x'));
+    for (size_t n: {10, 1000})
+        benchBoth("vectors/" + std::to_string(n), nested(n));
+    for (size_t n: {10, 1000})
+        benchBoth("map/" + std::to_string(n), strings(n));
+    for (size_t n: {1, 100})
+        benchImage("handler/" + std::to_string(n), replobHandler(n));
+    for (size_t n: {1, 10, 100})
+        benchImage("carryset/" + std::to_string(n), carrySet(n));
+
+    report();
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright 2015 Grigory Demchenko (aka gridem)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <synca/synca.h>
+#include <synca/log.h>
+
+#include "ut.h"
+
+using namespace synca;
+
+TEST(ThreadPool, fixed)
+{
+    ThreadPool tp(3, "tp");
+    scheduler<DefaultTag>().attach(tp);
+    ASSERT_EQ(3u, tp.threadCount());
+    goN(10, [] {
+        sleepFor(10);
+    });
+    waitForAll();
+    ASSERT_EQ(3u, tp.threadCount());
+}
+
+TEST(ThreadPool, elastic)
+{
+    ThreadPoolConfig config;
+    config.minThreads = 1;
+    config.maxThreads = 4;
+    config.growDelayUs = 1000;
+    config.idleTimeoutMs = 200;
+    ThreadPool tp(config, "tp");
+    scheduler<DefaultTag>().attach(tp);
+    ASSERT_EQ(1u, tp.threadCount());
+
+    Atomic<int> done;
+    for (int i = 0; i < 20; ++ i)
+    {
+        go([&] {
+            sleepFor(50);
+            ++ done;
+        });
+    }
+    waitFor([&] { return done == 20; });
+    size_t grown = tp.threadCount();
+    JLOG("grown to: " << grown);
+    ASSERT_TRUE(grown > 1);
+    ThreadPoolStats stats = tp.stats();
+    JLOG("queue delay p50/p90/p99: " << stats.delayP50Us << "/" << stats.delayP90Us << "/" << stats.delayP99Us);
+    ASSERT_TRUE(stats.delayP99Us >= stats.delayP50Us);
+
+    waitFor([&] { return tp.threadCount() == 1; });
+    waitForAll();
+}
+
+TEST(ThreadPool, stalled)
+{
+    ThreadPoolConfig config;
+    config.minThreads = 1;
+    config.maxThreads = 2;
+    config.growDelayUs = 1000;
+    ThreadPool tp(config, "tp");
+    scheduler<DefaultTag>().attach(tp);
+
+    // blocks the only thread until the next handler runs on the new one
+    Atomic<int> released;
+    tp.schedule([&] {
+        while (released == 0)
+            sleepFor(1);
+    });
+    tp.schedule([&] {
+        released.store(1);
+    });
+    waitFor([&] { return released == 1; });
+    ASSERT_EQ(2u, tp.threadCount());
+}
+
+TEST(ThreadPool, spin)
+{
+    ThreadPoolConfig config;
+    config.minThreads = 2;
+    config.maxThreads = 2;
+    config.spinUs = 200;
+    ThreadPool tp(config, "tp");
+    scheduler<DefaultTag>().attach(tp);
+
+    Atomic<int> done;
+    go([&] {
+        for (int i = 0; i < 100; ++ i)
+        {
+            reschedule();
+            ++ done;
+        }
+    });
+    waitFor([&] { return done == 100; });
+    sleepFor(10);
+    ThreadPoolStats stats = tp.stats();
+    JLOG("spin hits: " << stats.spinHits << ", parks: " << stats.parks);
+    ASSERT_TRUE(stats.spinHits >= 100);
+    ASSERT_TRUE(stats.parks > 0);
+    waitForAll();
+}
+
+CPPUT_TEST_MAIN
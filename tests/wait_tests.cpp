@@ -67,4 +67,153 @@ TEST(wait, 2)
     waitForAll();
 }
 
+TEST(wait, tryWaitForDone)
+{
+    ThreadPool tp(2, "wait");
+    scheduler<DefaultTag>().attach(tp);
+    service<TimeoutTag>().attach(tp);
+    Status cancelled = Status::Ok;
+    Status timedout = Status::Ok;
+    Status done = Status::Failed;
+    auto g = go([&] {
+        DetachableDoer d;
+        cancelled = tryWaitForDone();
+    });
+    go([&] {
+        Timeout t{10};
+        DetachableDoer d;
+        timedout = tryWaitForDone();
+    });
+    go([&] {
+        DetachableDoer d;
+        go([d]() mutable { d.done(); });
+        done = tryWaitForDone();
+    });
+    sleepFor(50);
+    g.cancel();
+    waitForAll();
+    ASSERT_TRUE(cancelled == Status::Cancelled);
+    ASSERT_TRUE(timedout == Status::Timedout);
+    ASSERT_TRUE(done == Status::Ok);
+}
+
+TEST(wait, result)
+{
+    synca::Result<int> ok{5};
+    ASSERT_TRUE(ok.ok());
+    ASSERT_EQ(5, ok.value());
+    synca::Result<int> failed{Status::Failed, "boom"};
+    ASSERT_TRUE(!failed);
+    bool thrown = false;
+    try
+    {
+        failed.value<NetworkError>();
+    }
+    catch (NetworkError& e)
+    {
+        thrown = true;
+        ASSERT_EQ(std::string("Synca error: Network error: boom"), e.what());
+    }
+    ASSERT_TRUE(thrown);
+    thrown = false;
+    try
+    {
+        synca::Result<>{Status::Cancelled}.value();
+    }
+    catch (CancelledEvent&)
+    {
+        thrown = true;
+    }
+    ASSERT_TRUE(thrown);
+}
+
+TEST(wait, goFirst)
+{
+    ThreadPool tp(3, "wait");
+    scheduler<DefaultTag>().attach(tp);
+    service<TimeoutTag>().attach(tp);
+    go([&] {
+        Atomic<int> completed;
+        auto r = goFirst<int>({
+            [&]() -> boost::optional<int> {
+                sleepa(1000);
+                ++ completed;
+                return 1;
+            }, [&]() -> boost::optional<int> {
+                return boost::none;
+            }, [&]() -> boost::optional<int> {
+                sleepa(10);
+                return 3;
+            }
+        });
+        ASSERT_TRUE(r);
+        ASSERT_EQ(3, *r);
+        // the loser was cancelled and has finished
+        ASSERT_EQ(0, completed.load());
+
+        r = goFirst<int>({
+            []() -> boost::optional<int> { return boost::none; },
+            []() -> boost::optional<int> { return boost::none; },
+        });
+        ASSERT_TRUE(!r);
+    });
+    waitForAll();
+}
+
+TEST(wait, goFirstHedged)
+{
+    ThreadPool tp(3, "wait");
+    scheduler<DefaultTag>().attach(tp);
+    service<TimeoutTag>().attach(tp);
+    go([&] {
+        Atomic<int> started;
+        auto r = goFirst<int>({
+            [&]() -> boost::optional<int> {
+                ++ started;
+                sleepa(10);
+                return 1;
+            }, [&]() -> boost::optional<int> {
+                ++ started;
+                return 2;
+            }
+        }, 1000);
+        ASSERT_EQ(1, *r);
+        ASSERT_EQ(1, started.load());
+
+        r = goFirst<int>({
+            [&]() -> boost::optional<int> {
+                sleepa(1000);
+                return 1;
+            }, [&]() -> boost::optional<int> {
+                return 2;
+            }
+        }, 10);
+        ASSERT_EQ(2, *r);
+    });
+    waitForAll();
+}
+
+TEST(wait, post)
+{
+    ThreadPool tp(2, "wait");
+    scheduler<DefaultTag>().attach(tp);
+    Atomic<int> ran;
+    Atomic<int> rejected;
+    for (int i = 0; i < 10; ++ i)
+        post([&] { ++ ran; });
+    post([&] {
+        try
+        {
+            waitForDone();
+        }
+        catch (std::exception&)
+        {
+            ++ rejected;
+        }
+    });
+    tp.wait();
+    ASSERT_EQ(10, ran.load());
+    ASSERT_EQ(1, rejected.load());
+}
+
 CPPUT_TEST_MAIN